@@ -1,6 +1,21 @@
 #ifdef APPLICATION_DEF
 #undef APPLICATION_DEF
 
+#include "engine/application/span.h"
+#include "engine/application/palette.h"
+#include "engine/application/sprite_sampling.h"
+#include "engine/application/sprite_runs.h"
+#include "engine/application/sprite_view.h"
+#include "engine/application/atlas.h"
+#include "engine/application/glyph_cache.h"
+#include "engine/application/decal_arena.h"
+#include "engine/application/decal_list.h"
+#include "engine/application/render_list.h"
+#include "engine/application/raster.h"
+#include "engine/application/compose.h"
+#include "engine/application/command_buffer.h"
+#include "engine/application/tile_raster.h"
+
 #pragma region engine_implementation
 namespace engine {
 	Pixel::Pixel() { 
@@ -126,10 +141,24 @@ namespace engine {
     }
 
 	Sprite::Sprite(int32_t w, int32_t h) {
-		width = w;		
-        height = h;
-		col_data.resize(width * height);
-		col_data.resize(width * height, default_pixel);
+		resize(w, h);
+		std::fill(col_data.begin(), col_data.end(), default_pixel);
+	}
+
+	Sprite::Sprite(int32_t w, int32_t h, engine::Palette* palette) {
+		this->palette = palette;
+		resize(w, h);
+		std::fill(index_data.begin(), index_data.end(), 0);
+	}
+
+	void Sprite::resize(int32_t w, int32_t h) {
+		constexpr int32_t row_texels = row_alignment / int32_t(sizeof(engine::Pixel));
+		width = std::max(w, 0);
+		height = std::max(h, 0);
+		pitch = (width + row_texels - 1) / row_texels * row_texels;
+		if (palette != nullptr) index_data.resize(size_t(pitch) * size_t(height));
+		else col_data.resize(size_t(pitch) * size_t(height));
+		mark_dirty();
 	}
 
 	Sprite::~Sprite() { col_data.clear(); }
@@ -139,24 +168,33 @@ namespace engine {
 	Pixel Sprite::get_pixel(const engine::int_vector_2d& a) const { return get_pixel(a.x, a.y); }
 	Pixel Sprite::get_pixel(int32_t x, int32_t y) const {
 		if (sample_mode == engine::Sprite::Mode::NORMAL) {
-			if (x >= 0 && x < width && y >= 0 && y < height)
-				return col_data[y * width + x];
-			else
+			if (x < 0 || x >= width || y < 0 || y >= height)
 				return Pixel(0, 0, 0, 0);
 		}
+		else if (sample_mode == engine::Sprite::Mode::PERIODIC) {
+			x = abs(x % width);
+			y = abs(y % height);
+		}
 		else {
-			if (sample_mode == engine::Sprite::Mode::PERIODIC)
-				return col_data[abs(y % height) * width + abs(x % width)];
-			else
-				return col_data[std::max(0, std::min(y, height-1)) * width + std::max(0, std::min(x, width-1))];
+			x = std::max(0, std::min(x, width - 1));
+			y = std::max(0, std::min(y, height - 1));
 		}
+
+		if (palette != nullptr)
+			return palette->colours[index_data[y * pitch + x]];
+		return col_data[y * pitch + x];
 	}
 
 	bool Sprite::set_pixel(const engine::int_vector_2d& a, Pixel p) { return set_pixel(a.x, a.y, p); }
 	bool Sprite::set_pixel(int32_t x, int32_t y, Pixel p)
 	{
 		if (x >= 0 && x < width && y >= 0 && y < height) {
-			col_data[y * width + x] = p;
+			if (palette != nullptr) {
+				palette->update();
+				index_data[y * pitch + x] = palette->find(p);
+			}
+			else col_data[y * pitch + x] = p;
+			mark_dirty(x, y, 1, 1);
 			return true;
 		}
 		else {
@@ -172,50 +210,130 @@ namespace engine {
 	Pixel Sprite::sample(const engine::float_vector_2d& uv) const { return sample(uv.x, uv.y); }
 
 	Pixel Sprite::sample_BL(float u, float v) const {
-		u = u * width - 0.5f;
-		v = v * height - 0.5f;
+		Pixel p;
+		sample_BL(&u, &v, &p, 1);
+		return p;
+	}
 
-		int x = (int)floor(u);
-		int y = (int)floor(v);
+	Pixel Sprite::sample_BL(const engine::float_vector_2d& uv) const { return sample_BL(uv.x, uv.y); }
 
-		float u_ratio = u - x;
-		float v_ratio = v - y;
+	Pixel* Sprite::get_data() { mark_dirty(); return col_data.data(); }
+	const Pixel* Sprite::get_data() const { return col_data.data(); }
 
-		float u_opposite = 1 - u_ratio;
-		float v_opposite = 1 - v_ratio;
+	void Sprite::mark_dirty() {
+		dirty_x1 = 0; dirty_y1 = 0;
+		dirty_x2 = width; dirty_y2 = height;
+		revision++;
+	}
 
-		engine::Pixel p1 = get_pixel(std::max(x, 0), std::max(y, 0));
-		engine::Pixel p2 = get_pixel(std::min(x + 1, (int)width - 1), std::max(y, 0));
-		engine::Pixel p3 = get_pixel(std::max(x, 0), std::min(y + 1, (int)height - 1));
-		engine::Pixel p4 = get_pixel(std::min(x + 1, (int)width - 1), std::min(y + 1, (int)height - 1));
+	void Sprite::mark_dirty(int32_t x, int32_t y, int32_t w, int32_t h) {
+		int32_t x1 = std::max(x, 0), y1 = std::max(y, 0);
+		int32_t x2 = std::min(x + w, width), y2 = std::min(y + h, height);
+		if (x1 >= x2 || y1 >= y2)
+			return;
+		if (dirty_x1 >= dirty_x2) {
+			dirty_x1 = x1; dirty_y1 = y1;
+			dirty_x2 = x2; dirty_y2 = y2;
+		}
+		else {
+			dirty_x1 = std::min(dirty_x1, x1); dirty_y1 = std::min(dirty_y1, y1);
+			dirty_x2 = std::max(dirty_x2, x2); dirty_y2 = std::max(dirty_y2, y2);
+		}
+		revision++;
+	}
 
-		return engine::Pixel(
-			(uint8_t)((p1.r * u_opposite + p2.r * u_ratio) * v_opposite + (p3.r * u_opposite + p4.r * u_ratio) * v_ratio),
-			(uint8_t)((p1.g * u_opposite + p2.g * u_ratio) * v_opposite + (p3.g * u_opposite + p4.g * u_ratio) * v_ratio),
-			(uint8_t)((p1.b * u_opposite + p2.b * u_ratio) * v_opposite + (p3.b * u_opposite + p4.b * u_ratio) * v_ratio));
+	bool Sprite::get_dirty(int32_t& x, int32_t& y, int32_t& w, int32_t& h) const {
+		if (dirty_x1 >= dirty_x2 || dirty_y1 >= dirty_y2)
+			return false;
+		x = dirty_x1; y = dirty_y1;
+		w = dirty_x2 - dirty_x1; h = dirty_y2 - dirty_y1;
+		return true;
 	}
 
-	Pixel Sprite::sample_BL(const engine::float_vector_2d& uv) const { return sample_BL(uv.x, uv.y); }
+	void Sprite::clear_dirty() {
+		dirty_x1 = dirty_y1 = dirty_x2 = dirty_y2 = 0;
+		clean_revision = revision;
+	}
+
+	uint32_t Sprite::dirty_revision() const { return clean_revision; }
+
+	Sprite::Version Sprite::version() const { return { revision, palette, (palette != nullptr) ? palette->revision : 0, true }; }
+
+	void Sprite::set_palette(engine::Palette* p) {
+		if (p != nullptr && palette == nullptr) {
+			p->update();
+			index_data.resize(col_data.size());
+			for (size_t i = 0; i < col_data.size(); i++)
+				index_data[i] = p->find(col_data[i]);
+			decltype(col_data)().swap(col_data);
+		}
+		else if (p == nullptr && palette != nullptr) {
+			col_data.resize(index_data.size());
+			expand(col_data.data());
+			std::vector<uint8_t>().swap(index_data);
+		}
+		palette = p;
+		mark_dirty();
+	}
+
+	bool Sprite::is_indexed() const { return palette != nullptr; }
+
+	uint8_t Sprite::get_index(int32_t x, int32_t y) const {
+		if (palette != nullptr && x >= 0 && x < width && y >= 0 && y < height)
+			return index_data[y * pitch + x];
+		return 0;
+	}
 
-	Pixel* Sprite::get_data() { return col_data.data(); }
+	bool Sprite::set_index(int32_t x, int32_t y, uint8_t index) {
+		if (palette != nullptr && x >= 0 && x < width && y >= 0 && y < height) {
+			index_data[y * pitch + x] = index;
+			mark_dirty(x, y, 1, 1);
+			return true;
+		}
+		return false;
+	}
+
+	uint8_t* Sprite::get_indices() { mark_dirty(); return index_data.data(); }
+	const uint8_t* Sprite::get_indices() const { return index_data.data(); }
+
+	void Sprite::expand(engine::Pixel* out) const {
+		if (palette == nullptr) {
+			std::copy(col_data.begin(), col_data.end(), out);
+			return;
+		}
+		const Pixel* colours = palette->colours.data();
+		for (size_t i = 0; i < index_data.size(); i++)
+			out[i] = colours[index_data[i]];
+	}
 
 	engine::Code Sprite::load_from_file(const std::string& img_file, engine::ResourcePack* pack) {
 		UNUSED(pack);
+		mark_dirty();
+		palette = nullptr;
+		index_data.clear();
 		return loader->load_img_resource(this, img_file, pack);
 	}
 
 	engine::Sprite* Sprite::duplicate() {
-		engine::Sprite* spr = new engine::Sprite(width, height);
-		std::memcpy(spr->get_data(), get_data(), width * height * sizeof(engine::Pixel));
+		engine::Sprite* spr = (palette != nullptr) ? new engine::Sprite(width, height, palette) : new engine::Sprite(width, height);
+		spr->col_data = col_data;
+		spr->index_data = index_data;
 		spr->sample_mode = sample_mode;
 		return spr;
 	}
 
 	engine::Sprite* Sprite::duplicate(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) {
 		engine::Sprite* spr = new engine::Sprite(size.x, size.y);
-		for (int y = 0; y < size.y; y++)
-			for (int x = 0; x < size.x; x++)
-				spr->set_pixel(x, y, get_pixel(pos.x + x, pos.y + y));
+		bool inside = pos.x >= 0 && pos.y >= 0 && pos.x + size.x <= width && pos.y + size.y <= height;
+		for (int y = 0; y < spr->height; y++) {
+			if (inside && palette == nullptr) {
+				std::memcpy(spr->col_data.data() + y * spr->pitch, col_data.data() + (pos.y + y) * pitch + pos.x, spr->width * sizeof(engine::Pixel));
+				continue;
+			}
+			for (int x = 0; x < spr->width; x++)
+				spr->col_data[y * spr->pitch + x] = get_pixel(pos.x + x, pos.y + y);
+		}
+		spr->sample_mode = sample_mode;
 		return spr;
 	}
 
@@ -234,17 +352,70 @@ namespace engine {
 		id = existing_texture_resource;
 	}
 
+	// textures are always RGBA, so indexed sprites go through this sprite on the way to and from them
+	static engine::Sprite& decal_staging(const engine::Sprite* sprite) {
+		static engine::Sprite staging;
+		staging.resize(sprite->width, sprite->height);
+		return staging;
+	}
+
+	// Uploads what changed since the last upload: nothing, the sprite's dirty region, or all of it
+	// when the size or palette changed, the region was cleared by an upload elsewhere, or the
+	// revision moved with no region marked, as it does for writes straight into col_data.
 	void Decal::update() {
 		if (sprite == nullptr) return;
 		UV_scale = { 1.0f / float(sprite->width), 1.0f / float(sprite->height) };
+
+		uint32_t palette_revision = sprite->is_indexed() ? sprite->palette->revision : 0;
+		bool whole = uploaded_size != sprite->size() || uploaded_palette != palette_revision || uploaded_revision != sprite->dirty_revision();
+		int32_t x = 0, y = 0, w = sprite->width, h = sprite->height;
+		if (!whole && !sprite->get_dirty(x, y, w, h)) {
+			if (sprite->revision == sprite->dirty_revision())
+				return;
+			whole = true;
+		}
+
 		renderer->apply_texture(id);
-		renderer->update_texture(id, sprite);
+		engine::Sprite* source = sprite;
+		if (sprite->is_indexed()) {
+			source = &decal_staging(sprite);
+			if (whole)
+				sprite->expand(source->col_data.data());
+			else {
+				const engine::Pixel* colours = sprite->palette->colours.data();
+				for (int32_t j = y; j < y + h; j++)
+					for (int32_t i = x; i < x + w; i++)
+						source->col_data[j * sprite->pitch + i] = colours[sprite->index_data[j * sprite->pitch + i]];
+			}
+		}
+		if (whole) renderer->update_texture(id, source);
+		else renderer->update_texture_region(id, source, x, y, w, h);
+
+		sprite->clear_dirty();
+		uploaded_size = sprite->size();
+		uploaded_revision = sprite->dirty_revision();
+		uploaded_palette = palette_revision;
 	}
 
 	void Decal::update_sprite() {
 		if (sprite == nullptr) return;
 		renderer->apply_texture(id);
-		renderer->read_texture(id, sprite);
+		if (sprite->is_indexed()) {
+			engine::Sprite& staging = decal_staging(sprite);
+			renderer->read_texture(id, &staging);
+			sprite->palette->update();
+			uint8_t* indices = sprite->get_indices();
+			for (size_t i = 0; i < staging.col_data.size(); i++)
+				indices[i] = sprite->palette->find(staging.col_data[i]);
+		}
+		else {
+			// the sprite now holds what the texture does
+			renderer->read_texture(id, sprite);
+			if (uploaded_size == sprite->size()) {
+				sprite->clear_dirty();
+				uploaded_revision = sprite->dirty_revision();
+			}
+		}
 	}
 
 	Decal::~Decal() {
@@ -442,6 +613,7 @@ namespace engine {
 	}
 
 	void Engine::set_screen_size(int w, int h) {
+		flush_draw();
 		screen_size = { w, h };
 		inv_screen_size = { 1.0f / float(w), 1.0f / float(h) };
 		
@@ -451,9 +623,11 @@ namespace engine {
 		}
 
 		set_draw_target(nullptr);
-		renderer->clear_buffer(engine::BLACK, true);
+		RenderList clear;
+		clear.clear_buffer(engine::BLACK, true);
+		execute_list(clear);
 		renderer->display_frame();
-		renderer->clear_buffer(engine::BLACK, true);
+		execute_list(clear);
 		renderer->update_viewport(view_pos, view_size);
 	}
 
@@ -478,6 +652,7 @@ namespace engine {
 #endif
 
 	void Engine::set_draw_target(Sprite* target) {
+		flush_draw();
 		if (target) {
 			draw_target = target;
 		}
@@ -488,6 +663,7 @@ namespace engine {
 	}
 
 	void Engine::set_draw_target(uint8_t layer, bool dirty) {
+		flush_draw();
 		if (layer < layers.size()) {
 			draw_target = layers[layer].draw_target.Sprite();
 			layers[layer].update = dirty;
@@ -528,6 +704,10 @@ namespace engine {
 	uint32_t Engine::create_layer() {
 		LayerDesc ld;
 		ld.draw_target.create(screen_size.x, screen_size.y);
+		if (layer_palette != nullptr) {
+			ld.draw_target.Sprite()->set_palette(layer_palette);
+			ld.draw_target.Decal()->update();
+		}
 		layers.push_back(std::move(ld));
 		return uint32_t(layers.size()) - 1;
 	}
@@ -578,31 +758,292 @@ namespace engine {
 	bool Engine::draw(const engine::int_vector_2d& pos, Pixel p) { return draw(pos.x, pos.y, p); }
 
 	bool Engine::draw(int32_t x, int32_t y, Pixel p) {
-		if (!draw_target) return false;
+		if (drawing != nullptr) {
+			bool drawn = false;
+			dispatch_mode(pixel_mode, [&](auto m) { drawn = drawing->plot<decltype(m)::value>(x, y, p); });
+			if (drawn)
+				draw_target->mark_dirty(x, y, 1, 1);
+			return drawn;
+		}
+
+#if defined(ENGINE_FINAL_DRAW)
+		if (deferred_draw || tile_raster) {
+			DrawCommand c(DrawCommand::PLOT, pixel_mode, blend_fixed, p);
+			c.v[0] = x; c.v[1] = y;
+			submit(c);
+			if (!draw_target)
+				return false;
+			ClipRect clip = clip_rect();
+			return x >= clip.x1 && y >= clip.y1 && x < clip.x2 && y < clip.y2 && (pixel_mode != Pixel::MASK || p.a == 255);
+		}
+#endif
 
-		if (pixel_mode == Pixel::NORMAL)
-			return draw_target->set_pixel(x, y, p);
+		bool drawn = false;
+		switch (pixel_mode) {
+		case Pixel::NORMAL: drawn = raster().plot<Pixel::NORMAL>(x, y, p); break;
+		case Pixel::MASK:   drawn = raster().plot<Pixel::MASK>(x, y, p); break;
+		case Pixel::ALPHA:  drawn = raster().plot<Pixel::ALPHA>(x, y, p); break;
+		case Pixel::CUSTOM: drawn = raster().plot<Pixel::CUSTOM>(x, y, p); break;
+		}
+		if (drawn)
+			draw_target->mark_dirty(x, y, 1, 1);
+		return drawn;
+	}
 
-		if (pixel_mode == Pixel::MASK)
-			if (p.a == 255)
-				return draw_target->set_pixel(x, y, p);
+	Raster Engine::raster() const {
+		Raster r;
+		if (draw_target && draw_target->is_indexed()) {
+			draw_target->palette->update();
+			r.indices = draw_target->index_data.data();
+			r.palette = draw_target->palette;
+		}
+		else if (draw_target) r.data = draw_target->col_data.data();
+		if (draw_target) {
+			r.width = draw_target->width;
+			r.height = draw_target->height;
+			r.pitch = draw_target->pitch;
+			ClipRect clip = clip_rect();
+			r.clip_x1 = clip.x1;
+			r.clip_y1 = clip.y1;
+			r.clip_x2 = clip.x2;
+			r.clip_y2 = clip.y2;
+		}
+		r.weight = blend_fixed;
+		r.custom = &func_pixel_mode;
+		return r;
+	}
 
-		if (pixel_mode == Pixel::ALPHA) {
-			Pixel d = draw_target->get_pixel(x, y);
-			
-            float a = (float)(p.a / 255.0f) * blend_factor;
-			float c = 1.0f - a;
-			float r = a * (float)p.r + c * (float)d.r;
-			float g = a * (float)p.g + c * (float)d.g;
-			float b = a * (float)p.b + c * (float)d.b;
-			
-            return draw_target->set_pixel(x, y, Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b));
+	// the top of the clip stack within the draw target, which needs to be set
+	Engine::ClipRect Engine::clip_rect() const {
+		ClipRect clip = { 0, 0, draw_target->width, draw_target->height };
+		if (!clip_stack.empty()) {
+			const ClipRect& top = clip_stack.back();
+			clip.x1 = std::min(std::max(top.x1, 0), clip.x2);
+			clip.y1 = std::min(std::max(top.y1, 0), clip.y2);
+			clip.x2 = std::max(std::min(top.x2, clip.x2), clip.x1);
+			clip.y2 = std::max(std::min(top.y2, clip.y2), clip.y1);
+		}
+		return clip;
+	}
+
+	void Engine::push_clip_rect(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) {
+		push_clip_rect(pos.x, pos.y, size.x, size.y);
+	}
+
+	void Engine::push_clip_rect(int32_t x, int32_t y, int32_t w, int32_t h) {
+		ClipRect clip = { x, y, x + std::max(w, 0), y + std::max(h, 0) };
+		if (!clip_stack.empty()) {
+			const ClipRect& top = clip_stack.back();
+			clip.x1 = std::max(clip.x1, top.x1);
+			clip.y1 = std::max(clip.y1, top.y1);
+			clip.x2 = std::max(std::min(clip.x2, top.x2), clip.x1);
+			clip.y2 = std::max(std::min(clip.y2, top.y2), clip.y1);
 		}
+		clip_stack.push_back(clip);
+	}
 
-		if (pixel_mode == Pixel::CUSTOM)
-			return draw_target->set_pixel(x, y, func_pixel_mode(x, y, p, draw_target->get_pixel(x, y)));
+	void Engine::pop_clip_rect() {
+		if (!clip_stack.empty())
+			clip_stack.pop_back();
+	}
 
-		return false;
+	// commands are bounded up front, which also marks the part of the draw target they write for the upload
+	void Engine::submit(DrawCommand& c) {
+		if (!draw_target || !bound(c))
+			return;
+		draw_target->mark_dirty(c.x1, c.y1, c.x2 - c.x1, c.y2 - c.y1);
+
+#if defined(ENGINE_FINAL_DRAW)
+		if (deferred_draw || tile_raster) {
+			if (c.mode != Pixel::CUSTOM) {
+				record(c);
+				return;
+			}
+			// custom blend functions may not be thread safe, so they run here in order
+			flush_draw();
+		}
+#else
+		// draw may be overridden, so the pixels go through it as CUSTOM writes, here and in order
+		if (c.type != DrawCommand::CLEAR) {
+			Raster target = raster(), through = target;
+			through.owner = this;
+			const Raster* outer = drawing;
+			Pixel::Mode mode = pixel_mode;
+			// strings pick their own mode, which draw has to see
+			drawing = &target;
+			pixel_mode = c.mode;
+			execute<Pixel::CUSTOM>(through, c);
+			pixel_mode = mode;
+			drawing = outer;
+			return;
+		}
+#endif
+
+		Raster r = raster();
+		dispatch_mode(c.mode, [&](auto m) { execute<decltype(m)::value>(r, c); });
+	}
+
+	void Engine::record(DrawCommand& c) {
+		if (c.type == DrawCommand::STRING || c.type == DrawCommand::STRING_PROP) {
+			draw_commands.strings.push_back(*c.text);
+			c.text = &draw_commands.strings.back();
+		}
+		draw_commands.commands.push_back(c);
+	}
+
+	bool Engine::bound(DrawCommand& c) {
+		switch (c.type) {
+		case DrawCommand::PLOT:
+			c.x1 = c.v[0]; c.y1 = c.v[1]; c.x2 = c.v[0] + 1; c.y2 = c.v[1] + 1;
+			break;
+		case DrawCommand::LINE:
+			c.x1 = std::min(c.v[0], c.v[2]); c.y1 = std::min(c.v[1], c.v[3]);
+			c.x2 = std::max(c.v[0], c.v[2]) + 1; c.y2 = std::max(c.v[1], c.v[3]) + 1;
+			break;
+		case DrawCommand::LINE_AA:
+			c.x1 = int32_t(std::floor(std::max(std::min(c.pos[0].x, c.pos[1].x), -1e9f))) - 1; c.y1 = int32_t(std::floor(std::max(std::min(c.pos[0].y, c.pos[1].y), -1e9f))) - 1;
+			c.x2 = int32_t(std::ceil(std::min(std::max(c.pos[0].x, c.pos[1].x), 1e9f))) + 2; c.y2 = int32_t(std::ceil(std::min(std::max(c.pos[0].y, c.pos[1].y), 1e9f))) + 2;
+			break;
+		case DrawCommand::CIRCLE:
+		case DrawCommand::FILL_CIRCLE:
+			c.x1 = c.v[0] - c.v[2]; c.y1 = c.v[1] - c.v[2];
+			c.x2 = c.v[0] + c.v[2] + 1; c.y2 = c.v[1] + c.v[2] + 1;
+			break;
+		case DrawCommand::FILL_RECT:
+			c.x1 = c.v[0]; c.y1 = c.v[1]; c.x2 = c.v[0] + c.v[2]; c.y2 = c.v[1] + c.v[3];
+			break;
+		case DrawCommand::FILL_TRIANGLE:
+			c.x1 = std::min({ c.v[0], c.v[2], c.v[4] }); c.y1 = std::min({ c.v[1], c.v[3], c.v[5] });
+			c.x2 = std::max({ c.v[0], c.v[2], c.v[4] }) + 1; c.y2 = std::max({ c.v[1], c.v[3], c.v[5] }) + 1;
+			break;
+		case DrawCommand::TEXTURED_TRIANGLE:
+			c.x1 = int32_t(std::min({ c.pos[0].x, c.pos[1].x, c.pos[2].x })) - 1; c.y1 = int32_t(std::min({ c.pos[0].y, c.pos[1].y, c.pos[2].y })) - 1;
+			c.x2 = int32_t(std::max({ c.pos[0].x, c.pos[1].x, c.pos[2].x })) + 2; c.y2 = int32_t(std::max({ c.pos[0].y, c.pos[1].y, c.pos[2].y })) + 2;
+			break;
+		case DrawCommand::SPRITE:
+			c.x1 = c.v[0]; c.y1 = c.v[1]; c.x2 = c.v[0] + c.v[6]; c.y2 = c.v[1] + c.v[7];
+			break;
+		case DrawCommand::STRING:
+		case DrawCommand::STRING_PROP: {
+			engine::int_vector_2d size = (c.type == DrawCommand::STRING) ? get_text_size(*c.text) : get_text_size_prop(*c.text);
+			c.x1 = c.v[0]; c.y1 = c.v[1]; c.x2 = c.v[0] + size.x * int32_t(c.flags); c.y2 = c.v[1] + size.y * int32_t(c.flags);
+			break; }
+		case DrawCommand::CLEAR:
+			c.x1 = 0; c.y1 = 0; c.x2 = draw_target->width; c.y2 = draw_target->height;
+			break;
+		}
+
+		ClipRect clip = clip_rect();
+		c.clip_x1 = clip.x1; c.clip_y1 = clip.y1;
+		c.clip_x2 = clip.x2; c.clip_y2 = clip.y2;
+		c.x1 = std::max(c.x1, clip.x1);
+		c.y1 = std::max(c.y1, clip.y1);
+		c.x2 = std::min(c.x2, clip.x2);
+		c.y2 = std::min(c.y2, clip.y2);
+		return c.x1 < c.x2 && c.y1 < c.y2;
+	}
+
+	template<Pixel::Mode M>
+	void Engine::execute(const Raster& r, const DrawCommand& c) {
+		switch (c.type) {
+		case DrawCommand::PLOT:              r.plot<M>(c.v[0], c.v[1], c.col); break;
+		case DrawCommand::LINE:              raster_line<M>(r, c.v[0], c.v[1], c.v[2], c.v[3], c.col, c.flags); break;
+		case DrawCommand::LINE_AA:           raster_line_aa<M>(r, c.pos[0].x, c.pos[0].y, c.pos[1].x, c.pos[1].y, c.col); break;
+		case DrawCommand::CIRCLE:            raster_circle<M>(r, c.v[0], c.v[1], c.v[2], c.col, uint8_t(c.flags)); break;
+		case DrawCommand::FILL_CIRCLE:       raster_fill_circle<M>(r, c.v[0], c.v[1], c.v[2], c.col); break;
+		case DrawCommand::FILL_RECT:         raster_fill_rect<M>(r, c.v[0], c.v[1], c.v[2], c.v[3], c.col); break;
+		case DrawCommand::FILL_TRIANGLE:     raster_fill_triangle<M>(r, c.v[0], c.v[1], c.v[2], c.v[3], c.v[4], c.v[5], c.col); break;
+		case DrawCommand::TEXTURED_TRIANGLE: raster_textured_triangle<M>(r, c.pos, c.uv, c.tint, c.flags ? c.depth : nullptr, c.sprite, c.v); break;
+		case DrawCommand::SPRITE:
+			if (c.v[6] == c.v[4] && c.v[7] == c.v[5])
+				r.blit<M>(c.v[0], c.v[1], c.sprite, c.v[2], c.v[3], c.v[4], c.v[5], c.flip);
+			else
+				r.blit_scaled<M>(c.v[0], c.v[1], c.v[6], c.v[7], c.sprite, c.v[2], c.v[3], c.v[4], c.v[5], c.flip);
+			break;
+		case DrawCommand::STRING:            raster_string<M>(r, c.v[0], c.v[1], *c.text, c.col, c.flags, false); break;
+		case DrawCommand::STRING_PROP:       raster_string<M>(r, c.v[0], c.v[1], *c.text, c.col, c.flags, true); break;
+		case DrawCommand::CLEAR:
+			if (r.indices != nullptr)
+				for (int32_t y = r.clip_y1; y < r.clip_y2; y++)
+					std::memset(r.indices + y * r.pitch + r.clip_x1, r.palette->find(c.col), r.clip_x2 - r.clip_x1);
+			else if (r.clip_x1 == 0 && r.clip_x2 == r.width)
+				span_fill(r.data + r.clip_y1 * r.pitch, c.col, (r.clip_y2 - r.clip_y1) * r.pitch);
+			else
+				for (int32_t y = r.clip_y1; y < r.clip_y2; y++)
+					span_fill(r.data + y * r.pitch + r.clip_x1, c.col, r.clip_x2 - r.clip_x1);
+			break;
+		}
+	}
+
+	void Engine::enable_deferred_draw(const bool enable) {
+		flush_draw();
+		deferred_draw = enable;
+	}
+
+	void Engine::enable_tile_raster(const bool enable, uint32_t workers, int32_t tile_size) {
+		flush_draw();
+		tile_raster.reset();
+		if (enable) {
+			if (workers == 0) workers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+			tile_raster = std::make_unique<TileRaster>(workers, tile_size);
+		}
+	}
+
+	void Engine::enable_indexed_layers(engine::Palette* palette) {
+		flush_draw();
+		layer_palette = palette;
+		for (auto& layer : layers) {
+			if (layer.draw_target.Sprite() != nullptr)
+				layer.draw_target.Sprite()->set_palette(palette);
+			layer.update = true;
+		}
+	}
+
+	void Engine::flush_draw() {
+		if (draw_commands.commands.empty() || !draw_target) {
+			draw_commands.reset();
+			return;
+		}
+
+		draw_commands.optimize();
+		const std::vector<DrawCommand>& commands = draw_commands.commands;
+
+		if (!tile_raster) {
+			Raster r = raster();
+			for (const DrawCommand& c : commands) {
+				r.weight = c.weight;
+				r.clip_x1 = c.clip_x1; r.clip_y1 = c.clip_y1;
+				r.clip_x2 = c.clip_x2; r.clip_y2 = c.clip_y2;
+				dispatch_mode(c.mode, [&](auto m) { execute<decltype(m)::value>(r, c); });
+			}
+		}
+		else {
+			TileRaster& t = *tile_raster;
+			t.bin(commands, draw_target->width, draw_target->height);
+
+			Raster target = raster();
+			t.run(int32_t(t.bins.size()), [&](int32_t tile) {
+				if (t.bins[tile].empty())
+					return;
+
+				Raster r = target;
+				int32_t tile_x1 = (tile % t.tiles_x) * t.tile_size;
+				int32_t tile_y1 = (tile / t.tiles_x) * t.tile_size;
+				int32_t tile_x2 = std::min(tile_x1 + t.tile_size, r.width);
+				int32_t tile_y2 = std::min(tile_y1 + t.tile_size, r.height);
+
+				for (uint32_t i : t.bins[tile]) {
+					const DrawCommand& c = commands[i];
+					r.weight = c.weight;
+					r.clip_x1 = std::max(tile_x1, c.clip_x1);
+					r.clip_y1 = std::max(tile_y1, c.clip_y1);
+					r.clip_x2 = std::max(std::min(tile_x2, c.clip_x2), r.clip_x1);
+					r.clip_y2 = std::max(std::min(tile_y2, c.clip_y2), r.clip_y1);
+					dispatch_mode(c.mode, [&](auto m) { execute<decltype(m)::value>(r, c); });
+				}
+			});
+		}
+		draw_commands.reset();
 	}
 
 	void Engine::draw_line(const engine::int_vector_2d& pos1, const engine::int_vector_2d& pos2, Pixel p, uint32_t pattern) { 
@@ -610,85 +1051,178 @@ namespace engine {
     }
 
 	void Engine::draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern) {
-		int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
-		dx = x2 - x1; dy = y2 - y1;
+		DrawCommand c(DrawCommand::LINE, pixel_mode, blend_fixed, p);
+		c.v[0] = x1; c.v[1] = y1; c.v[2] = x2; c.v[3] = y2;
+		c.flags = pattern;
+		submit(c);
+	}
 
+	template<Pixel::Mode M>
+	void Engine::raster_line(const Raster& r, int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern) {
 		auto rol = [&](void) { pattern = (pattern << 1) | (pattern >> 31); return pattern & 1; };
+		auto skip = [&](int64_t k) { k &= 31; if (k) pattern = (pattern << k) | (pattern >> (32 - k)); };
+		bool solid = (pattern == 0xFFFFFFFF);
 
-		engine::int_vector_2d p1(x1, y1), p2(x2, y2);
-
-		x1 = p1.x; y1 = p1.y;
-		x2 = p2.x; y2 = p2.y;
-
-		if (dx == 0) { // vertical
+		if (x1 == x2) { // vertical
 			if (y2 < y1) std::swap(y1, y2);
-			for (y = y1; y <= y2; y++) if (rol()) draw(x1, y, p);
+			if (x1 < r.clip_x1 || x1 >= r.clip_x2) return;
+			if (y1 < r.clip_y1) { skip(int64_t(r.clip_y1) - y1); y1 = r.clip_y1; }
+			y2 = std::min(y2, r.clip_y2 - 1);
+			for (int32_t y = y1, o = y1 * r.pitch + x1; y <= y2; y++, o += r.pitch)
+				if (solid || rol()) r.write<M>(o, x1, y, p);
 			return;
 		}
 
-		if (dy == 0) { // horizontal
+		if (y1 == y2) { // horizontal
 			if (x2 < x1) std::swap(x1, x2);
-			for (x = x1; x <= x2; x++) if (rol()) draw(x, y1, p);
+			if (solid) { r.span<M>(x1, x2 + 1, y1, p); return; }
+			if (y1 < r.clip_y1 || y1 >= r.clip_y2) return;
+			if (x1 < r.clip_x1) { skip(int64_t(r.clip_x1) - x1); x1 = r.clip_x1; }
+			x2 = std::min(x2, r.clip_x2 - 1);
+			for (int32_t x = x1, o = y1 * r.pitch + x1; x <= x2; x++, o++)
+				if (rol()) r.write<M>(o, x, y1, p);
 			return;
 		}
 
-		dx1 = abs(dx); 
-        dy1 = abs(dy);
-		
-        px = 2 * dy1 - dx1;	
-        py = 2 * dx1 - dy1;
-		
-        if (dy1 <= dx1) {
-			if (dx >= 0) {
-				x = x1; 
-                y = y1; 
-                xe = x2;
+		// Bresenham from the end with the lower major coordinate. After k steps along the
+		// major axis the minor axis has moved n(k) times, which is known in closed form, so
+		// the steps inside the clip rectangle are found up front on both axes.
+		int64_t dx = int64_t(x2) - x1, dy = int64_t(y2) - y1;
+		int64_t dx1 = std::abs(dx), dy1 = std::abs(dy);
+		bool steep = dy1 > dx1;
+		if (steep ? dy < 0 : dx < 0) { std::swap(x1, x2); std::swap(y1, y2); }
+		int32_t minor_step = ((dx < 0) == (dy < 0)) ? 1 : -1;
+
+		// major and minor axis of the line, with their clip ranges, closed
+		int64_t a = steep ? y1 : x1, b = steep ? x1 : y1;
+		int64_t da = steep ? dy1 : dx1, db = steep ? dx1 : dy1;
+		int64_t a_lo = steep ? r.clip_y1 : r.clip_x1, a_hi = (steep ? r.clip_y2 : r.clip_x2) - 1;
+		int64_t b_lo = steep ? r.clip_x1 : r.clip_y1, b_hi = (steep ? r.clip_x2 : r.clip_y2) - 1;
+
+		// the steep half rounds ties the other way, which the offset of the fraction carries
+		int64_t bias = steep ? da - 1 : da;
+		auto n_of   = [&](int64_t k) { return floor_div(2 * db * k + bias, 2 * da); };
+		auto k_from = [&](int64_t t) { return -floor_div(bias - 2 * da * t, 2 * db); }; // first k with n(k) >= t
+		auto k_to   = [&](int64_t t) { return floor_div(2 * da * (t + 1) - bias - 1, 2 * db); }; // last k with n(k) <= t
+
+		int64_t n_lo = (minor_step > 0) ? b_lo - b : b - b_hi;
+		int64_t n_hi = (minor_step > 0) ? b_hi - b : b - b_lo;
+		int64_t k1 = std::max({ int64_t(0), a_lo - a, k_from(n_lo) });
+		int64_t k2 = std::min({ da, a_hi - a, k_to(n_hi) });
+		if (k1 > k2)
+			return;
+
+		skip(k1);
+		int64_t n = n_of(k1);
+		int64_t e = 2 * db * (k1 + 1) - da - 2 * da * n;
+		int32_t x = int32_t(steep ? b + minor_step * n : a + k1);
+		int32_t y = int32_t(steep ? a + k1 : b + minor_step * n);
+		int32_t o = y * r.pitch + x;
+
+		// one step along each axis, in x, y and the offset into the target
+		int32_t ax = steep ? 0 : 1, ay = steep ? 1 : 0, ao = steep ? r.pitch : 1;
+		int32_t bx = steep ? minor_step : 0, by = steep ? 0 : minor_step, bo = by * r.pitch + bx;
+		int64_t e_major = 2 * db, e_minor = 2 * (db - da);
+
+		for (int64_t k = k1;; k++) {
+			if (solid || rol()) r.write<M>(o, x, y, p);
+			if (k == k2)
+				break;
+			x += ax; y += ay; o += ao;
+			if (steep ? e <= 0 : e < 0) {
+				e += e_major;
 			}
 			else {
-				x = x2; 
-                y = y2; 
-                xe = x1;
+				x += bx; y += by; o += bo;
+				e += e_minor;
 			}
+		}
+	}
 
-			if (rol()) draw(x, y, p);
+	void Engine::draw_line_aa(const engine::float_vector_2d& pos1, const engine::float_vector_2d& pos2, Pixel p) {
+		draw_line_aa(pos1.x, pos1.y, pos2.x, pos2.y, p);
+	}
 
-			for (i = 0; x < xe; i++) {
-				x = x + 1;
-				if (px < 0) {
-					px = px + 2 * dy1;
-                }
-				else {
-					if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) y = y + 1; else y = y - 1;
-					px = px + 2 * (dy1 - dx1);
-				}
-				if (rol()) draw(x, y, p);
-			}
-		}
-		else {
-			if (dy >= 0) {
-				x = x1; 
-                y = y1; 
-                ye = y2;
-			}
-			else {
-				x = x2; 
-                y = y2; 
-                ye = y1;
-			}
+	void Engine::draw_line_aa(float x1, float y1, float x2, float y2, Pixel p) {
+		if (!std::isfinite(x1) || !std::isfinite(y1) || !std::isfinite(x2) || !std::isfinite(y2))
+			return;
+		DrawCommand c(DrawCommand::LINE_AA, pixel_mode, blend_fixed, p);
+		c.pos[0] = { x1, y1 };
+		c.pos[1] = { x2, y2 };
+		submit(c);
+	}
 
-			if (rol()) draw(x, y, p);
+	// ARTICLE: https://en.wikipedia.org/wiki/Xiaolin_Wu%27s_line_algorithm
+	// Every column of the major axis covers two pixels of the minor axis, split by the
+	// fraction of the line's position, which runs in 16.16 fixed point.
+	template<Pixel::Mode M>
+	void Engine::raster_line_aa(const Raster& r, float fx1, float fy1, float fx2, float fy2, Pixel p) {
+		double x1 = fx1, y1 = fy1, x2 = fx2, y2 = fy2;
+		bool steep = std::abs(y2 - y1) > std::abs(x2 - x1);
+		if (steep) { std::swap(x1, y1); std::swap(x2, y2); }
+		if (x1 > x2) { std::swap(x1, x2); std::swap(y1, y2); }
+
+		// x runs along the major axis from here on, y along the minor one
+		int64_t a_lo = steep ? r.clip_y1 : r.clip_x1, a_hi = (steep ? r.clip_y2 : r.clip_x2) - 1;
+		int64_t b_lo = steep ? r.clip_x1 : r.clip_y1, b_hi = (steep ? r.clip_x2 : r.clip_y2) - 1;
+		auto plot = [&](int64_t a, int64_t b, uint32_t coverage) {
+			if (steep) r.cover<M>(int32_t(b), int32_t(a), p, coverage); else r.cover<M>(int32_t(a), int32_t(b), p, coverage);
+		};
 
-			for (i = 0; y < ye; i++) {
-				y = y + 1;
-				if (py <= 0) {
-					py = py + 2 * dx1;
-                }
-				else {
-					if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) x = x + 1; else x = x - 1;
-					py = py + 2 * (dx1 - dy1);
-				}
-				if (rol()) draw(x, y, p);
-			}
+		// Lines that miss the clip rectangle and a margin cost nothing. Far away ends are cut at a fixed
+		// limit, never at the clip rectangle, so the pixels drawn do not depend on where it is.
+		constexpr double limit = double(1 << 24);
+		double dx = x2 - x1, dy = y2 - y1;
+		double gradient = (dx == 0.0) ? 1.0 : dy / dx;
+		if (x2 < double(a_lo - 2) || x1 > double(a_hi + 2))
+			return;
+		if (x1 < -limit) { y1 += gradient * (-limit - x1); x1 = -limit; }
+		if (x2 > limit) { y2 -= gradient * (x2 - limit); x2 = limit; }
+		if (std::max(y1, y2) < double(b_lo - 2) || std::min(y1, y2) > double(b_hi + 2))
+			return;
+
+		// the end points cover their column by how much of it the line reaches
+		auto coverage = [](double c) { return uint32_t(std::min(std::max(c, 0.0), 1.0) * 256.0 + 0.5); };
+		int64_t a1 = int64_t(std::floor(x1 + 0.5)), a2 = int64_t(std::floor(x2 + 0.5));
+		double gap1 = 1.0 - ((x1 + 0.5) - std::floor(x1 + 0.5)), gap2 = (x2 + 0.5) - std::floor(x2 + 0.5);
+		if (a1 == a2) gap1 = gap2 = (x2 - x1) * 0.5;
+		double b1 = y1 + gradient * (double(a1) - x1), b2 = y2 + gradient * (double(a2) - x2);
+		double f1 = b1 - std::floor(b1), f2 = b2 - std::floor(b2);
+		plot(a1, int64_t(std::floor(b1)), coverage((1.0 - f1) * gap1));
+		plot(a1, int64_t(std::floor(b1)) + 1, coverage(f1 * gap1));
+		plot(a2, int64_t(std::floor(b2)), coverage((1.0 - f2) * gap2));
+		plot(a2, int64_t(std::floor(b2)) + 1, coverage(f2 * gap2));
+
+		// The columns between them, in 32.32 fixed point from the first end whatever the clip
+		// rectangle, which then only narrows the range to the columns and rows inside it.
+		int64_t k1 = std::max(a1 + 1, a_lo), k2 = std::min(a2 - 1, a_hi);
+		if (k1 > k2)
+			return;
+
+		constexpr int64_t one = int64_t(1) << 32;
+		int64_t step = int64_t(std::llround(gradient * double(one)));
+		int64_t b = int64_t(std::llround(b1 * double(one))) + (k1 - a1) * step;
+		int64_t lo = (b_lo - 1) * one, hi = (b_hi + 1) * one - 1;
+		if (step > 0) {
+			int64_t skip = std::max(int64_t(0), -floor_div(b - lo, step));
+			k2 = std::min(k2, k1 + floor_div(hi - b, step));
+			k1 += skip; b += skip * step;
+		}
+		else if (step < 0) {
+			int64_t skip = std::max(int64_t(0), -floor_div(hi - b, -step));
+			k2 = std::min(k2, k1 + floor_div(b - lo, -step));
+			k1 += skip; b += skip * step;
+		}
+		else if (b < lo || b > hi) {
+			return;
+		}
+
+		// the pixel beside the line may still fall outside, cover() keeps its test for that
+		for (int64_t k = k1; k <= k2; k++, b += step) {
+			int64_t row = floor_div(b, one);
+			uint32_t f = uint32_t((b - row * one) >> 24);
+			plot(k, row, 256 - f);
+			plot(k, row + 1, f);
 		}
 	}
 
@@ -697,7 +1231,15 @@ namespace engine {
     }
 
 	void Engine::draw_circle(int32_t x, int32_t y, int32_t radius, Pixel p, uint8_t mask) {
-		if (radius < 0 || x < -radius || y < -radius || x - get_draw_target_width() > radius || y - get_draw_target_height() > radius)
+		DrawCommand c(DrawCommand::CIRCLE, pixel_mode, blend_fixed, p);
+		c.v[0] = x; c.v[1] = y; c.v[2] = radius;
+		c.flags = mask;
+		submit(c);
+	}
+
+	template<Pixel::Mode M>
+	void Engine::raster_circle(const Raster& r, int32_t x, int32_t y, int32_t radius, Pixel p, uint8_t mask) {
+		if (radius < 0 || x + radius < r.clip_x1 || y + radius < r.clip_y1 || x - radius >= r.clip_x2 || y - radius >= r.clip_y2)
 			return;
 
 		if (radius > 0) {
@@ -705,17 +1247,21 @@ namespace engine {
 			int y0 = radius;
 			int d = 3 - 2 * radius;
 
+			// circles wholly inside the clip rectangle skip the test per pixel
+			bool inside = r.contains(x - radius, y - radius, x + radius + 1, y + radius + 1);
+			auto plot = [&](int32_t px, int32_t py) { if (inside) r.put<M>(px, py, p); else r.plot<M>(px, py, p); };
+
 			while (y0 >= x0) { // 1/8 of circle
-				if (mask & 0x01) draw(x + x0, y - y0, p); // upper right right
-				if (mask & 0x04) draw(x + y0, y + x0, p); // lower lower right
-				if (mask & 0x10) draw(x - x0, y + y0, p); // lower left left
-				if (mask & 0x40) draw(x - y0, y - x0, p); // upper upper left
+				if (mask & 0x01) plot(x + x0, y - y0); // upper right right
+				if (mask & 0x04) plot(x + y0, y + x0); // lower lower right
+				if (mask & 0x10) plot(x - x0, y + y0); // lower left left
+				if (mask & 0x40) plot(x - y0, y - x0); // upper upper left
 
 				if (x0 != 0 && x0 != y0) {
-					if (mask & 0x02) draw(x + y0, y - x0, p); // upper upper right
-					if (mask & 0x08) draw(x + x0, y + y0, p); // lower right right
-					if (mask & 0x20) draw(x - y0, y + x0, p); // lower lower left
-					if (mask & 0x80) draw(x - x0, y - y0, p); // upper left left
+					if (mask & 0x02) plot(x + y0, y - x0); // upper upper right
+					if (mask & 0x08) plot(x + x0, y + y0); // lower right right
+					if (mask & 0x20) plot(x - y0, y + x0); // lower lower left
+					if (mask & 0x80) plot(x - x0, y - y0); // upper left left
 				}
 
 				if (d < 0)
@@ -725,7 +1271,7 @@ namespace engine {
 			}
 		}
 		else {
-			draw(x, y, p);
+			r.plot<M>(x, y, p);
         }
 	}
 
@@ -734,7 +1280,14 @@ namespace engine {
     }
 
 	void Engine::fill_circle(int32_t x, int32_t y, int32_t radius, Pixel p) {
-		if (radius < 0 || x < -radius || y < -radius || x - get_draw_target_width() > radius || y - get_draw_target_height() > radius)
+		DrawCommand c(DrawCommand::FILL_CIRCLE, pixel_mode, blend_fixed, p);
+		c.v[0] = x; c.v[1] = y; c.v[2] = radius;
+		submit(c);
+	}
+
+	template<Pixel::Mode M>
+	void Engine::raster_fill_circle(const Raster& r, int32_t x, int32_t y, int32_t radius, Pixel p) {
+		if (radius < 0 || x + radius < r.clip_x1 || y + radius < r.clip_y1 || x - radius >= r.clip_x2 || y - radius >= r.clip_y2)
 			return;
 
 		if (radius > 0) {
@@ -742,10 +1295,7 @@ namespace engine {
 			int y0 = radius;
 			int d = 3 - 2 * radius;
 
-			auto drawline = [&](int sx, int ex, int y) {
-				for (int x = sx; x <= ex; x++)
-					draw(x, y, p);
-			};
+			auto drawline = [&](int sx, int ex, int y) { r.span<M>(sx, ex + 1, y, p); };
 
 			while (y0 >= x0) {
 				drawline(x - y0, x + y0, y - x0);
@@ -764,7 +1314,7 @@ namespace engine {
 			}
 		}
 		else {
-			draw(x, y, p);
+			r.plot<M>(x, y, p);
         }
 	}
 
@@ -780,13 +1330,18 @@ namespace engine {
 	}
 
 	void Engine::clear(Pixel p) {
-		int pixels = get_draw_target_width() * get_draw_target_height();
-		Pixel* m = get_draw_target()->get_data();
-		for (int i = 0; i < pixels; i++) m[i] = p;
+		if (!draw_target)
+			return;
+
+		DrawCommand c(DrawCommand::CLEAR, Pixel::NORMAL, 256, p);
+		submit(c);
 	}
 
+	// a list of its own, hooks may clear between the frame's lists
 	void Engine::clear_buffer(Pixel p, bool depth) { 
-        renderer->clear_buffer(p, depth);
+        RenderList clear;
+        clear.clear_buffer(p, depth);
+        execute_list(clear);
     }
 
 	engine::Sprite* Engine::get_font_sprite() { 
@@ -851,22 +1406,28 @@ namespace engine {
     }
 
 	void Engine::fill_rect(int32_t x, int32_t y, int32_t w, int32_t h, Pixel p) {
+		DrawCommand c(DrawCommand::FILL_RECT, pixel_mode, blend_fixed, p);
+		c.v[0] = x; c.v[1] = y; c.v[2] = w; c.v[3] = h;
+		submit(c);
+	}
+
+	template<Pixel::Mode M>
+	void Engine::raster_fill_rect(const Raster& r, int32_t x, int32_t y, int32_t w, int32_t h, Pixel p) {
 		int32_t x2 = x + w;
 		int32_t y2 = y + h;
 
-		if (x < 0) x = 0;
-		if (x >= (int32_t)get_draw_target_width()) x = (int32_t)get_draw_target_width();
-		if (y < 0) y = 0;
-		if (y >= (int32_t)get_draw_target_height()) y = (int32_t)get_draw_target_height();
+		if (x < r.clip_x1) x = r.clip_x1;
+		if (x >= r.clip_x2) x = r.clip_x2;
+		if (y < r.clip_y1) y = r.clip_y1;
+		if (y >= r.clip_y2) y = r.clip_y2;
 
-		if (x2 < 0) x2 = 0;
-		if (x2 >= (int32_t)get_draw_target_width()) x2 = (int32_t)get_draw_target_width();
-		if (y2 < 0) y2 = 0;
-		if (y2 >= (int32_t)get_draw_target_height()) y2 = (int32_t)get_draw_target_height();
+		if (x2 < r.clip_x1) x2 = r.clip_x1;
+		if (x2 >= r.clip_x2) x2 = r.clip_x2;
+		if (y2 < r.clip_y1) y2 = r.clip_y1;
+		if (y2 >= r.clip_y2) y2 = r.clip_y2;
 
-		for (int i = x; i < x2; i++)
-			for (int j = y; j < y2; j++)
-				draw(i, j, p);
+		for (int j = y; j < y2; j++)
+			r.span<M>(x, x2, j, p);
 	}
 
 	void Engine::draw_triangle(const engine::int_vector_2d& pos1, const engine::int_vector_2d& pos2, const engine::int_vector_2d& pos3, Pixel p) { 
@@ -883,334 +1444,300 @@ namespace engine {
         fill_triangle(pos1.x, pos1.y, pos2.x, pos2.y, pos3.x, pos3.y, p); 
     }
 
-    // found online
 	void Engine::fill_triangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p) {
-		auto drawline = [&](int sx, int ex, int ny) { for (int i = sx; i <= ex; i++) draw(i, ny, p); };
-
-		int t1x, t2x, y, minx, maxx, t1xp, t2xp;
-		bool changed1 = false;
-		bool changed2 = false;
-		int signx1, signx2, dx1, dy1, dx2, dy2;
-		int e1, e2;
-
-		if (y1 > y2) { std::swap(y1, y2); std::swap(x1, x2); }
-		if (y1 > y3) { std::swap(y1, y3); std::swap(x1, x3); }
-		if (y2 > y3) { std::swap(y2, y3); std::swap(x2, x3); }
+		DrawCommand c(DrawCommand::FILL_TRIANGLE, pixel_mode, blend_fixed, p);
+		c.v[0] = x1; c.v[1] = y1; c.v[2] = x2; c.v[3] = y2; c.v[4] = x3; c.v[5] = y3;
+		submit(c);
+	}
 
-		t1x = t2x = x1; y = y1;
-		dx1 = (int)(x2 - x1);
+	template<Pixel::Mode M>
+	void Engine::raster_fill_triangle(const Raster& r, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p) {
+		constexpr int32_t one = 1 << Raster::subpixel_bits;
+		constexpr int32_t limit = 1 << 26;
+		auto fixed = [&](int32_t v) { return std::min(limit, std::max(-limit, v)) * one; };
+		int32_t x[3] = { fixed(x1), fixed(x2), fixed(x3) };
+		int32_t y[3] = { fixed(y1), fixed(y2), fixed(y3) };
+		r.triangle(x, y, [&](int32_t sx, int32_t ex, int32_t ny) { r.span<M>(sx, ex, ny, p); });
+	}
 
-		if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-		else signx1 = 1;
+	void Engine::fill_textured_triangle(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, engine::Sprite* spr_tex) {
+		fill_textured_triangle(points.data(), tex.data(), color.data(), engine::SpriteView(spr_tex));
+	}
 
-		dy1 = (int)(y2 - y1);
-		dx2 = (int)(x3 - x1);
+	void Engine::fill_textured_triangle(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, const engine::SpriteView& view) {
+		fill_textured_triangle(points.data(), tex.data(), color.data(), view);
+	}
 
-		if (dx2 < 0) { dx2 = -dx2; signx2 = -1; }
-		else signx2 = 1;
+	void Engine::fill_textured_triangle(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, engine::Sprite* spr_tex, const float* depth) {
+		submit_textured(points, tex, color, depth, 0, 1, 2, engine::SpriteView(spr_tex));
+	}
 
-		dy2 = (int)(y3 - y1);
+	void Engine::fill_textured_triangle(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const engine::SpriteView& view, const float* depth) {
+		submit_textured(points, tex, color, depth, 0, 1, 2, view);
+	}
 
-		if (dy1 > dx1) { std::swap(dx1, dy1); changed1 = true; }
-		if (dy2 > dx2) { std::swap(dy2, dx2); changed2 = true; }
+	void Engine::submit_textured(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const float* depth, uint32_t i1, uint32_t i2, uint32_t i3, const engine::SpriteView& view) {
+		DrawCommand c(DrawCommand::TEXTURED_TRIANGLE, pixel_mode, blend_fixed, engine::WHITE);
+		const uint32_t index[3] = { i1, i2, i3 };
+		for (int i = 0; i < 3; i++) {
+			c.pos[i] = points[index[i]];
+			c.uv[i] = (tex != nullptr) ? tex[index[i]] : engine::float_vector_2d(0.0f, 0.0f);
+			c.tint[i] = (color != nullptr) ? color[index[i]] : engine::WHITE;
+			if (depth != nullptr) c.depth[i] = depth[index[i]];
+		}
+		c.flags = (depth != nullptr) ? 1 : 0;
+		c.sprite = view.sprite;
+		c.v[0] = view.x; c.v[1] = view.y; c.v[2] = view.width; c.v[3] = view.height;
+		if (view.sprite != nullptr) view.sprite->update_mipmaps();
+		submit(c);
+	}
 
-		e2 = (int)(dx2 >> 1);
+	template<Pixel::Mode M>
+	void Engine::raster_textured_triangle(const Raster& r, const engine::float_vector_2d* points, const engine::float_vector_2d* in_tex, const engine::Pixel* in_color, const float* depth, const engine::Sprite* spr_tex, const int32_t* view) {
+		constexpr float one = float(1 << Raster::subpixel_bits);
+		constexpr float limit = float(1 << 26);
 
-		if (y1 == y2) goto next;
-		
-        e1 = (int)(dx1 >> 1);
+		int32_t x[3], y[3];
+		float px[3], py[3];
+		for (int i = 0; i < 3; i++) {
+			x[i] = int32_t(std::floor(std::min(limit, std::max(-limit, points[i].x)) * one + 0.5f));
+			y[i] = int32_t(std::floor(std::min(limit, std::max(-limit, points[i].y)) * one + 0.5f));
+			px[i] = float(x[i]) / one;
+			py[i] = float(y[i]) / one;
+		}
 
-		for (int i = 0; i < dx1;) {
-			t1xp = 0; t2xp = 0;
-			if (t1x < t2x) { 
-                minx = t1x; 
-                maxx = t2x; 
-            }
-			else { 
-                minx = t2x; 
-                maxx = t1x; 
-            }
+		float dx1 = px[1] - px[0], dy1 = py[1] - py[0];
+		float dx2 = px[2] - px[0], dy2 = py[2] - py[0];
+		float area = dx1 * dy2 - dx2 * dy1;
+		if (area == 0.0f)
+			return;
 
-			while (i < dx1) {
-				i++;
-				e1 += dy1;
-				while (e1 >= dx1) {
-					e1 -= dx1;
-					if (changed1) t1xp = signx1;
-					else          goto next1;
+		// u and v in texels of the view, then r, g, b, a, as planes over the screen. With depth
+		// every plane holds the attribute over depth, and a last plane holds one over depth.
+		constexpr int attribs = 7;
+		int32_t view_x = view[0], view_y = view[1];
+		int32_t tex_w = (spr_tex != nullptr) ? view[2] : 0;
+		int32_t tex_h = (spr_tex != nullptr) ? view[3] : 0;
+		float tw = float(tex_w), th = float(tex_h);
+
+		float value[3][attribs];
+		for (int i = 0; i < 3; i++) {
+			float q = (depth != nullptr) ? 1.0f / depth[i] : 1.0f;
+			value[i][0] = in_tex[i].x * tw * q;
+			value[i][1] = in_tex[i].y * th * q;
+			value[i][2] = in_color[i].r * q;
+			value[i][3] = in_color[i].g * q;
+			value[i][4] = in_color[i].b * q;
+			value[i][5] = in_color[i].a * q;
+			value[i][6] = q;
+		}
+
+		float ddx[attribs], ddy[attribs];
+		for (int k = 0; k < attribs; k++) {
+			float d1 = value[1][k] - value[0][k];
+			float d2 = value[2][k] - value[0][k];
+			ddx[k] = (d1 * dy2 - d2 * dy1) / area;
+			ddy[k] = (d2 * dx1 - d1 * dx2) / area;
+		}
+
+		// Same texel as SpriteView::sample, read directly when it is inside. Pixels are handled as
+		// packed words: byte stores may alias anything, which would force reloads every pixel.
+		bool textured = (spr_tex != nullptr && tex_w > 0 && tex_h > 0);
+		const Pixel* tex_data = (textured && !spr_tex->is_indexed()) ? spr_tex->get_data() + view_y * spr_tex->pitch + view_x : nullptr;
+		const uint8_t* tex_index = (textured && spr_tex->is_indexed()) ? spr_tex->get_indices() + view_y * spr_tex->pitch + view_x : nullptr;
+		const Pixel* tex_colours = (tex_index != nullptr) ? spr_tex->palette->colours.data() : nullptr;
+		int32_t tex_pitch = (spr_tex != nullptr) ? spr_tex->pitch : 0;
+		engine::Sprite::Mode tex_mode = (spr_tex != nullptr) ? spr_tex->sample_mode : engine::Sprite::Mode::NORMAL;
+
+		auto texel = [=](int32_t tx, int32_t ty) {
+			tx = std::min(tx, tex_w - 1);
+			ty = std::min(ty, tex_h - 1);
+			if (tx < 0 || ty < 0) {
+				// the sample mode applies at the edges of the view
+				if (tex_mode == engine::Sprite::Mode::NORMAL)
+					return 0u;
+				if (tex_mode == engine::Sprite::Mode::PERIODIC) {
+					tx = abs(tx % tex_w);
+					ty = abs(ty % tex_h);
 				}
-				if (changed1) break;
-				else t1x += signx1;
-			}
-		next1:
-			while (1) {
-				e2 += dy2;
-				while (e2 >= dx2) {
-					e2 -= dx2;
-					if (changed2) t2xp = signx2;
-					else          goto next2;
+				else {
+					tx = std::max(tx, 0);
+					ty = std::max(ty, 0);
 				}
-				if (changed2)     break;
-				else              t2x += signx2;
 			}
-		next2:
-			if (minx > t1x) minx = t1x;
-			if (minx > t2x) minx = t2x;
-			if (maxx < t1x) maxx = t1x;
-			if (maxx < t2x) maxx = t2x;
-
-			drawline(minx, maxx, y);
-			
-            if (!changed1) t1x += signx1;
-			t1x += t1xp;
-			
-            if (!changed2) t2x += signx2;
-			t2x += t2xp;
-			y += 1;
-			
-            if (y == y2) break;
-		}
-	next:
-		dx1 = (int)(x3 - x2); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-		else signx1 = 1;
-
-		dy1 = (int)(y3 - y2);
-		t1x = x2;
-
-		if (dy1 > dx1) {
-			std::swap(dy1, dx1);
-			changed1 = true;
-		}
-		else changed1 = false;
+			return (tex_index != nullptr) ? tex_colours[tex_index[ty * tex_pitch + tx]].n : tex_data[ty * tex_pitch + tx].n;
+		};
 
-		e1 = (int)(dx1 >> 1);
+		auto modulate = [](uint32_t c, uint32_t t) {
+			uint32_t out = 0;
+			for (int s = 0; s < 32; s += 8)
+				out |= ((((c >> s) & 0xFF) * ((t >> s) & 0xFF)) / 255) << s;
+			return out;
+		};
 
-		for (int i = 0; i <= dx1; i++) {
-			t1xp = 0; t2xp = 0;
-			if (t1x < t2x) { 
-                minx = t1x; 
-                maxx = t2x; 
-            }
-			else { 
-                minx = t2x; 
-                maxx = t1x; 
-            }
-			
-            while (i < dx1) {
-				e1 += dy1;
-				while (e1 >= dx1) {
-					e1 -= dx1;
-					if (changed1) { t1xp = signx1; break; }
-					else          goto next3;
+		thread_local std::vector<Pixel> line;
+
+		// Sprites with mip levels are filtered. The planes are evaluated at every pixel and the
+		// level follows the texels one pixel covers, which is constant without depth. The levels
+		// belong to the whole sprite, so a filtered view blends across its edges with its neighbours.
+		if (textured && spr_tex->mip_count() > 1) {
+			float sprite_w = float(spr_tex->width), sprite_h = float(spr_tex->height);
+			thread_local std::vector<Pixel> texels;
+			thread_local std::vector<float> su, sv, lod;
+			auto channel = [](float c) { return uint32_t(std::min(255.0f, std::max(0.0f, c + 0.5f))); };
+			auto footprint = [](float ux, float vx, float uy, float vy) {
+				return 0.5f * std::log2(std::max({ ux * ux + vx * vx, uy * uy + vy * vy, 1e-12f }));
+			};
+			float affine_lod = footprint(ddx[0], ddx[1], ddy[0], ddy[1]);
+
+			r.triangle(x, y, [&](int32_t sx, int32_t ex, int32_t ny) {
+				float cy = float(ny) + 0.5f - py[0];
+				float row[attribs], dx[attribs];
+				for (int k = 0; k < attribs; k++) {
+					row[k] = value[0][k] + ddy[k] * cy;
+					dx[k] = ddx[k];
 				}
 
-				if (changed1) break;
-				else   	   	  t1x += signx1;
-				if (i < dx1) i++;
-			}
-		next3:
-			while (t2x != x3) {
-				e2 += dy2;
-				while (e2 >= dx2) {
-					e2 -= dx2;
-					if (changed2) t2xp = signx2;
-					else          goto next4;
+				int32_t count = ex - sx;
+				line.resize(count);
+				texels.resize(count);
+				su.resize(count);
+				sv.resize(count);
+				lod.resize(count);
+				uint32_t* out = &line[0].n;
+				for (int32_t i = 0; i < count; i++) {
+					float cx = float(sx + i) + 0.5f - px[0];
+					float z = (depth != nullptr) ? 1.0f / (row[6] + dx[6] * cx) : 1.0f;
+					float at[attribs - 1];
+					for (int k = 0; k < attribs - 1; k++) at[k] = (row[k] + dx[k] * cx) * z;
+
+					out[i] = channel(at[2]) | (channel(at[3]) << 8) | (channel(at[4]) << 16) | (channel(at[5]) << 24);
+					su[i] = (float(view_x) + at[0]) / sprite_w;
+					sv[i] = (float(view_y) + at[1]) / sprite_h;
+					// with depth, u is a plane over one over depth and so are its derivatives
+					lod[i] = (depth != nullptr)
+						? footprint((dx[0] - at[0] * dx[6]) * z, (dx[1] - at[1] * dx[6]) * z, (ddy[0] - at[0] * ddy[6]) * z, (ddy[1] - at[1] * ddy[6]) * z)
+						: affine_lod;
 				}
-				if (changed2)     break;
-				else              t2x += signx2;
-			}
-		next4:
-			if (minx > t1x) minx = t1x;
-			if (minx > t2x) minx = t2x;
-			if (maxx < t1x) maxx = t1x;
-			if (maxx < t2x) maxx = t2x;
 
-			drawline(minx, maxx, y);
-			
-            if (!changed1) t1x += signx1;
-			t1x += t1xp;
-			
-            if (!changed2) t2x += signx2;
-			t2x += t2xp;
-			y += 1;
-			
-            if (y > y3) return;
+				spr_tex->sample_TL(su.data(), sv.data(), lod.data(), texels.data(), count);
+				for (int32_t i = 0; i < count; i++) out[i] = modulate(out[i], texels[i].n);
+				r.row<M>(sx, ny, line.data(), 1, count);
+			});
+			return;
 		}
-	}
 
-	void Engine::fill_textured_triangle(const std::vector<engine::float_vector_2d>& points, std::vector<engine::float_vector_2d> tex, std::vector<engine::Pixel> color, engine::Sprite* spr_tex) {
-		engine::int_vector_2d p1 = points[0];
-		engine::int_vector_2d p2 = points[1];
-		engine::int_vector_2d p3 = points[2];
-
-		if (p2.y < p1.y) {
-            std::swap(p1.y, p2.y); 
-            std::swap(p1.x, p2.x); 
-            std::swap(tex[0].x, tex[1].x); 
-            std::swap(tex[0].y, tex[1].y); 
-            std::swap(color[0], color[1]);
-        }
+		if (depth == nullptr) {
+			// Affine: 16.16 fixed point stepped by integer adds. A span starts from the value at a
+			// fixed column of its row, so the result does not depend on where the span was clipped.
+			constexpr double fixed = 65536.0;
+			int64_t step[attribs - 1];
+			for (int k = 0; k < attribs - 1; k++)
+				step[k] = int64_t(std::floor(double(ddx[k]) * fixed + 0.5));
+
+			int32_t ref = int32_t(std::floor(px[0]));
+			auto channel = [](int64_t c) { return uint32_t(std::min<int64_t>(255, std::max<int64_t>(0, (c + 0x8000) >> 16))); };
+			auto whole = [](int64_t t) { return int32_t(t >= 0 ? t >> 16 : -(-t >> 16)); };
+
+			r.triangle(x, y, [&](int32_t sx, int32_t ex, int32_t ny) {
+				double cx = double(ref) + 0.5 - px[0];
+				double cy = double(ny) + 0.5 - py[0];
+				int64_t at[attribs - 1], dt[attribs - 1];
+				for (int k = 0; k < attribs - 1; k++) {
+					at[k] = int64_t(std::floor((value[0][k] + ddx[k] * cx + ddy[k] * cy) * fixed + 0.5)) + step[k] * (sx - ref);
+					dt[k] = step[k];
+				}
 
-		if (p3.y < p1.y) {
-            std::swap(p1.y, p3.y); 
-            std::swap(p1.x, p3.x); 
-            std::swap(tex[0].x, tex[2].x); 
-            std::swap(tex[0].y, tex[2].y); 
-            std::swap(color[0], color[2]);
-        }
+				int32_t count = ex - sx;
+				line.resize(count);
+				uint32_t* out = &line[0].n;
+				for (int32_t i = 0; i < count; i++) {
+					uint32_t pixel = channel(at[2]) | (channel(at[3]) << 8) | (channel(at[4]) << 16) | (channel(at[5]) << 24);
+					if (textured) pixel = modulate(pixel, texel(whole(at[0]), whole(at[1])));
+					out[i] = pixel;
+					for (int k = 0; k < attribs - 1; k++) at[k] += dt[k];
+				}
+				r.row<M>(sx, ny, line.data(), 1, count);
+			});
+			return;
+		}
 
-		if (p3.y < p2.y) {
-            std::swap(p2.y, p3.y); 
-            std::swap(p2.x, p3.x); 
-            std::swap(tex[1].x, tex[2].x); 
-            std::swap(tex[1].y, tex[2].y); 
-            std::swap(color[1], color[2]);
-        }
+		// perspective correct: the planes are evaluated at every pixel and divided by the interpolated one over depth
+		auto channel = [](float c) { return uint32_t(std::min(255.0f, std::max(0.0f, c + 0.5f))); };
+		auto whole = [=](float t) { return int32_t(std::min(limit, std::max(-limit, t))); };
 
-		engine::int_vector_2d pos1 = p2 - p1;
-		engine::float_vector_2d tex1 = tex[1] - tex[0];
-		int dcr1 = color[1].r - color[0].r;
-		int dcg1 = color[1].g - color[0].g;
-		int dcb1 = color[1].b - color[0].b;
-		int dca1 = color[1].a - color[0].a;
-
-		engine::int_vector_2d pos2 = p3 - p1;
-		engine::float_vector_2d tex2 = tex[2] - tex[0];
-		int dcr2 = color[2].r - color[0].r;
-		int dcg2 = color[2].g - color[0].g;
-		int dcb2 = color[2].b - color[0].b;
-		int dca2 = color[2].a - color[0].a;
-
-		float dax_step = 0, dbx_step = 0, dcr1_step = 0, dcr2_step = 0,	dcg1_step = 0, dcg2_step = 0, dcb1_step = 0, dcb2_step = 0,	dca1_step = 0, dca2_step = 0;
-		engine::float_vector_2d tex_1_step, tex_2_step;
-
-		if (pos1.y) {
-			dax_step = pos1.x / (float)abs(pos1.y);
-			tex_1_step = tex1 / (float)abs(pos1.y);
-			dcr1_step = dcr1 / (float)abs(pos1.y);
-			dcg1_step = dcg1 / (float)abs(pos1.y);
-			dcb1_step = dcb1 / (float)abs(pos1.y);
-			dca1_step = dca1 / (float)abs(pos1.y);
-		}
-
-		if (pos2.y) {
-			dbx_step = pos2.x / (float)abs(pos2.y);
-			tex_2_step = tex2 / (float)abs(pos2.y);
-			dcr2_step = dcr2 / (float)abs(pos2.y);
-			dcg2_step = dcg2 / (float)abs(pos2.y);
-			dcb2_step = dcb2 / (float)abs(pos2.y);
-			dca2_step = dca2 / (float)abs(pos2.y);
-		}
-
-		engine::int_vector_2d start;
-		engine::int_vector_2d end;
-		int start_idx;
-
-		for (int pass = 0; pass < 2; pass++) {
-			if (pass == 0) {
-				start = p1; 
-                end = p2;
-                start_idx = 0;
+		r.triangle(x, y, [&](int32_t sx, int32_t ex, int32_t ny) {
+			float cy = float(ny) + 0.5f - py[0];
+			float row[attribs], dx[attribs];
+			for (int k = 0; k < attribs; k++) {
+				row[k] = value[0][k] + ddy[k] * cy;
+				dx[k] = ddx[k];
 			}
-			else {
-				pos1 = p3 - p2;
-				tex1 = tex[2] - tex[1];
-				dcr1 = color[2].r - color[1].r;
-				dcg1 = color[2].g - color[1].g;
-				dcb1 = color[2].b - color[1].b;
-				dca1 = color[2].a - color[1].a;
-				dcr1_step = 0; 
-                dcg1_step = 0; 
-                dcb1_step = 0; 
-                dca1_step = 0;
-
-				if (pos2.y) dbx_step = pos2.x / (float)abs(pos2.y);
-				if (pos1.y) {
-					dax_step = pos1.x / (float)abs(pos1.y);
-					tex_1_step = tex1 / (float)abs(pos1.y);
-					dcr1_step = dcr1 / (float)abs(pos1.y);
-					dcg1_step = dcg1 / (float)abs(pos1.y);
-					dcb1_step = dcb1 / (float)abs(pos1.y);
-					dca1_step = dca1 / (float)abs(pos1.y);
-				}
 
-				start = p2;
-                end = p3;
-                start_idx = 1;
+			int32_t count = ex - sx;
+			line.resize(count);
+			uint32_t* out = &line[0].n;
+			for (int32_t i = 0; i < count; i++) {
+				float cx = float(sx + i) + 0.5f - px[0];
+				float z = 1.0f / (row[6] + dx[6] * cx);
+				float at[attribs - 1];
+				for (int k = 0; k < attribs - 1; k++) at[k] = (row[k] + dx[k] * cx) * z;
+
+				uint32_t pixel = channel(at[2]) | (channel(at[3]) << 8) | (channel(at[4]) << 16) | (channel(at[5]) << 24);
+				if (textured) pixel = modulate(pixel, texel(whole(at[0]), whole(at[1])));
+				out[i] = pixel;
 			}
+			r.row<M>(sx, ny, line.data(), 1, count);
+		});
+	}
 
-			if (pos1.y) {
-				for (int i = start.y; i <= end.y; i++) {
-					int ax = int(start.x + (float)(i - start.y) * dax_step);
-					int bx = int(p1.x + (float)(i - p1.y) * dbx_step);
-
-					engine::float_vector_2d tex_s(tex[start_idx].x + (float)(i - start.y) * tex_1_step.x, tex[start_idx].y + (float)(i - start.y) * tex_1_step.y);
-					engine::float_vector_2d tex_e(tex[0].x + (float)(i - p1.y) * tex_2_step.x, tex[0].y + (float)(i - p1.y) * tex_2_step.y);
-
-					engine::Pixel col_s(color[start_idx].r + uint8_t((float)(i - start.y) * dcr1_step), color[start_idx].g + uint8_t((float)(i - start.y) * dcg1_step),
-						color[start_idx].b + uint8_t((float)(i - start.y) * dcb1_step), color[start_idx].a + uint8_t((float)(i - start.y) * dca1_step));
-
-					engine::Pixel col_e(color[0].r + uint8_t((float)(i - p1.y) * dcr2_step), color[0].g + uint8_t((float)(i - p1.y) * dcg2_step),
-						color[0].b + uint8_t((float)(i - p1.y) * dcb2_step), color[0].a + uint8_t((float)(i - p1.y) * dca2_step));
-
-					if (ax > bx) { 
-                        std::swap(ax, bx); 
-                        std::swap(tex_s, tex_e); 
-                        std::swap(col_s, col_e); 
-                    }
+	void Engine::fill_textured_polygon(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, engine::Sprite* spr_tex, engine::DecalStructure structure) {
+		fill_textured_polygon(points, tex, color, engine::SpriteView(spr_tex), structure);
+	}
 
-					float tstep = 1.0f / ((float)(bx - ax));
-					float t = 0.0f;
+	void Engine::fill_textured_polygon(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, const engine::SpriteView& view, engine::DecalStructure structure) {
+		if (tex.size() < points.size() || color.size() < points.size())
+			return;
 
-					for (int j = ax; j < bx; j++) {
-						engine::Pixel pixel = pixel_lerp(col_s, col_e, t);
-						if (spr_tex != nullptr) pixel *= spr_tex->sample(tex_s.lerp(tex_e, t));
-						draw(j, i, pixel);
-						t += tstep;
-					}
-				}
-			}
-		}			
+		fill_textured_polygon(points.data(), tex.data(), color.data(), uint32_t(points.size()), view, structure);
 	}
 
-	void Engine::fill_textured_polygon(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, engine::Sprite* spr_tex, engine::DecalStructure structure) {
-		if (structure == engine::DecalStructure::LINE)
-			return;
+	void Engine::fill_textured_polygon(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, uint32_t count, engine::Sprite* spr_tex, engine::DecalStructure structure, const float* depth) {
+		fill_textured_polygon(points, tex, color, count, engine::SpriteView(spr_tex), structure, depth);
+	}
 
-		if (points.size() < 3 || tex.size() < 3 || color.size() < 3)
+	void Engine::fill_textured_polygon(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, uint32_t count, const engine::SpriteView& view, engine::DecalStructure structure, const float* depth) {
+		if (structure == engine::DecalStructure::LINE || count < 3)
 			return;
 
 		if (structure == engine::DecalStructure::LIST) {
-			for (int tri = 0; tri < points.size() / 3; tri++) {
-				std::vector<engine::float_vector_2d> p = { points[tri * 3 + 0], points[tri * 3 + 1], points[tri * 3 + 2] };
-				std::vector<engine::float_vector_2d> t = { tex[tri * 3 + 0], tex[tri * 3 + 1], tex[tri * 3 + 2] };
-				std::vector<engine::Pixel> c = { color[tri * 3 + 0], color[tri * 3 + 1], color[tri * 3 + 2] };
-				fill_textured_triangle(p, t, c, spr_tex);
-			}
+			for (uint32_t tri = 0; tri + 2 < count; tri += 3)
+				submit_textured(points, tex, color, depth, tri, tri + 1, tri + 2, view);
 			return;
 		}
 
 		if (structure == engine::DecalStructure::STRIP) {
-			for (int tri = 2; tri < points.size(); tri++) {
-				std::vector<engine::float_vector_2d> p = { points[tri - 2], points[tri-1], points[tri] };
-				std::vector<engine::float_vector_2d> t = { tex[tri - 2], tex[tri - 1], tex[tri] };
-				std::vector<engine::Pixel> c = { color[tri - 2], color[tri - 1], color[tri] };
-				fill_textured_triangle(p, t, c, spr_tex);
-			}
+			for (uint32_t tri = 2; tri < count; tri++)
+				submit_textured(points, tex, color, depth, tri - 2, tri - 1, tri, view);
 			return;
 		}
 
 		if (structure == engine::DecalStructure::FAN) {
-			for (int tri = 2; tri < points.size(); tri++) {
-				std::vector<engine::float_vector_2d> p = { points[0], points[tri - 1], points[tri] };
-				std::vector<engine::float_vector_2d> t = { tex[0], tex[tri - 1], tex[tri] };
-				std::vector<engine::Pixel> c = { color[0], color[tri - 1], color[tri] };
-				fill_textured_triangle(p, t, c, spr_tex);
-			}
+			for (uint32_t tri = 2; tri < count; tri++)
+				submit_textured(points, tex, color, depth, 0, tri - 1, tri, view);
 			return;
 		}
 	}
 
+	void Engine::fill_textured_mesh(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const uint32_t* indices, uint32_t index_count, engine::Sprite* spr_tex, const float* depth) {
+		fill_textured_mesh(points, tex, color, indices, index_count, engine::SpriteView(spr_tex), depth);
+	}
+
+	void Engine::fill_textured_mesh(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const uint32_t* indices, uint32_t index_count, const engine::SpriteView& view, const float* depth) {
+		for (uint32_t i = 0; i + 2 < index_count; i += 3)
+			submit_textured(points, tex, color, depth, indices[i], indices[i + 1], indices[i + 2], view);
+	}
+
 	void Engine::draw_sprite(const engine::int_vector_2d& pos, Sprite* sprite, uint32_t scale, uint8_t flip) { 
         draw_sprite(pos.x, pos.y, sprite, scale, flip); 
     }
@@ -1219,37 +1746,7 @@ namespace engine {
 		if (sprite == nullptr)
 			return;
 
-		int32_t fxs = 0, fxm = 1, fx = 0;
-		int32_t fys = 0, fym = 1, fy = 0;
-		
-        if (flip & engine::Sprite::Flip::HORIZ) { 
-            fxs = sprite->width - 1;
-            fxm = -1; 
-        }
-
-		if (flip & engine::Sprite::Flip::VERT) { 
-            fys = sprite->height - 1; 
-            fym = -1; 
-        }
-
-		if (scale > 1) {
-			fx = fxs;
-			for (int32_t i = 0; i < sprite->width; i++, fx += fxm) {
-				fy = fys;
-				for (int32_t j = 0; j < sprite->height; j++, fy += fym)
-					for (uint32_t is = 0; is < scale; is++)
-						for (uint32_t js = 0; js < scale; js++)
-							draw(x + (i * scale) + is, y + (j * scale) + js, sprite->get_pixel(fx, fy));
-			}
-		}
-		else {
-			fx = fxs;
-			for (int32_t i = 0; i < sprite->width; i++, fx += fxm) {
-				fy = fys;
-				for (int32_t j = 0; j < sprite->height; j++, fy += fym)
-					draw(x + i, y + j, sprite->get_pixel(fx, fy));
-			}
-		}
+		draw_partial_sprite(x, y, sprite, 0, 0, sprite->width, sprite->height, scale, flip);
 	}
 
 	void Engine::draw_partial_sprite(const engine::int_vector_2d& pos, Sprite* sprite, const engine::int_vector_2d& sourcepos, const engine::int_vector_2d& size, uint32_t scale, uint8_t flip) { 
@@ -1260,37 +1757,97 @@ namespace engine {
 		if (sprite == nullptr)
 			return;
 
-		int32_t fxs = 0, fxm = 1, fx = 0;
-		int32_t fys = 0, fym = 1, fy = 0;
+		int32_t s = int32_t(std::max(scale, 1u));
+		draw_partial_scaled_sprite(x, y, w * s, h * s, sprite, ox, oy, w, h, flip);
+	}
 
-		if (flip & engine::Sprite::Flip::HORIZ) { 
-            fxs = w - 1; 
-            fxm = -1; 
-        }
+	void Engine::draw_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, Sprite* sprite, uint8_t flip) {
+		draw_scaled_sprite(pos.x, pos.y, size.x, size.y, sprite, flip);
+	}
 
-		if (flip & engine::Sprite::Flip::VERT) { 
-            fys = h - 1; 
-            fym = -1; 
-        }
+	void Engine::draw_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, Sprite* sprite, uint8_t flip) {
+		if (sprite == nullptr)
+			return;
 
-		if (scale > 1) {
-			fx = fxs;
-			for (int32_t i = 0; i < w; i++, fx += fxm) {
-				fy = fys;
-				for (int32_t j = 0; j < h; j++, fy += fym)
-					for (uint32_t is = 0; is < scale; is++)
-						for (uint32_t js = 0; js < scale; js++)
-							draw(x + (i * scale) + is, y + (j * scale) + js, sprite->get_pixel(fx + ox, fy + oy));
-			}
-		}
-		else {
-			fx = fxs;
-			for (int32_t i = 0; i < w; i++, fx += fxm) {
-				fy = fys;
-				for (int32_t j = 0; j < h; j++, fy += fym)
-					draw(x + i, y + j, sprite->get_pixel(fx + ox, fy + oy));
-			}
-		}
+		draw_partial_scaled_sprite(x, y, w, h, sprite, 0, 0, sprite->width, sprite->height, flip);
+	}
+
+	void Engine::draw_partial_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, Sprite* sprite, const engine::int_vector_2d& source_pos, const engine::int_vector_2d& source_size, uint8_t flip) {
+		draw_partial_scaled_sprite(pos.x, pos.y, size.x, size.y, sprite, source_pos.x, source_pos.y, source_size.x, source_size.y, flip);
+	}
+
+	void Engine::draw_partial_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, Sprite* sprite, int32_t ox, int32_t oy, int32_t sw, int32_t sh, uint8_t flip) {
+		if (sprite == nullptr)
+			return;
+
+		DrawCommand c(DrawCommand::SPRITE, pixel_mode, blend_fixed, engine::WHITE);
+		c.v[0] = x; c.v[1] = y; c.v[2] = ox; c.v[3] = oy; c.v[4] = sw; c.v[5] = sh; c.v[6] = w; c.v[7] = h;
+		c.flip = flip;
+		c.sprite = sprite;
+		sprite->update_compiled();
+		submit(c);
+	}
+
+	void Engine::draw_partial_sprite(const engine::int_vector_2d& pos, engine::Atlas& atlas, int32_t region, uint32_t scale, uint8_t flip) {
+		draw_partial_sprite(pos.x, pos.y, atlas, region, scale, flip);
+	}
+
+	void Engine::draw_partial_sprite(int32_t x, int32_t y, engine::Atlas& atlas, int32_t region, uint32_t scale, uint8_t flip) {
+		if (!atlas.has_region(region))
+			return;
+		const engine::Atlas::Region& r = atlas.get_region(region);
+		draw_partial_sprite(x, y, atlas.get_sprite(r.page), r.x, r.y, r.w, r.h, scale, flip);
+	}
+
+	void Engine::draw_sprite(const engine::int_vector_2d& pos, const engine::SpriteView& view, uint32_t scale, uint8_t flip) {
+		draw_sprite(pos.x, pos.y, view, scale, flip);
+	}
+
+	void Engine::draw_sprite(int32_t x, int32_t y, const engine::SpriteView& view, uint32_t scale, uint8_t flip) {
+		draw_partial_sprite(x, y, view.sprite, view.x, view.y, view.width, view.height, scale, flip);
+	}
+
+	void Engine::draw_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, const engine::SpriteView& view, uint8_t flip) {
+		draw_scaled_sprite(pos.x, pos.y, size.x, size.y, view, flip);
+	}
+
+	void Engine::draw_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, const engine::SpriteView& view, uint8_t flip) {
+		draw_partial_scaled_sprite(x, y, w, h, view.sprite, view.x, view.y, view.width, view.height, flip);
+	}
+
+	// the source rectangle clipped to the view, with the destination rectangle cut down to match
+	static engine::SpriteView view_source(const engine::SpriteView& view, int32_t ox, int32_t oy, int32_t sw, int32_t sh, int32_t& x, int32_t& y, int32_t& w, int32_t& h, uint8_t flip) {
+		engine::SpriteView source = view.sub(ox, oy, sw, sh);
+		if (sw <= 0 || sh <= 0 || source.width <= 0 || source.height <= 0) {
+			w = h = 0;
+			return source;
+		}
+		int32_t left = source.x - view.x - ox, top = source.y - view.y - oy;
+		int32_t right = sw - left - source.width, bottom = sh - top - source.height;
+		x += ((flip & engine::Sprite::HORIZ) ? right : left) * w / sw;
+		y += ((flip & engine::Sprite::VERT) ? bottom : top) * h / sh;
+		w = source.width * w / sw;
+		h = source.height * h / sh;
+		return source;
+	}
+
+	void Engine::draw_partial_sprite(const engine::int_vector_2d& pos, const engine::SpriteView& view, const engine::int_vector_2d& source_pos, const engine::int_vector_2d& size, uint32_t scale, uint8_t flip) {
+		draw_partial_sprite(pos.x, pos.y, view, source_pos.x, source_pos.y, size.x, size.y, scale, flip);
+	}
+
+	void Engine::draw_partial_sprite(int32_t x, int32_t y, const engine::SpriteView& view, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale, uint8_t flip) {
+		int32_t s = int32_t(std::max(scale, 1u));
+		draw_partial_scaled_sprite(x, y, w * s, h * s, view, ox, oy, w, h, flip);
+	}
+
+	void Engine::draw_partial_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, const engine::SpriteView& view, const engine::int_vector_2d& source_pos, const engine::int_vector_2d& source_size, uint8_t flip) {
+		draw_partial_scaled_sprite(pos.x, pos.y, size.x, size.y, view, source_pos.x, source_pos.y, source_size.x, source_size.y, flip);
+	}
+
+	void Engine::draw_partial_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, const engine::SpriteView& view, int32_t ox, int32_t oy, int32_t sw, int32_t sh, uint8_t flip) {
+		engine::SpriteView source = view_source(view, ox, oy, sw, sh, x, y, w, h, flip);
+		if (w > 0 && h > 0)
+			draw_scaled_sprite(x, y, w, h, source, flip);
 	}
 
 	void Engine::set_decal_mode(const engine::DecalMode& mode) { 
@@ -1301,6 +1858,39 @@ namespace engine {
         decal_structure = structure; 
     }
 
+	DecalVertex* Engine::decal_vertices(DecalInstance& di, uint32_t points) {
+		DecalArena& arena = (recording_list != nullptr) ? recording_list->arena : decal_arena;
+		di.points = points;
+		di.first = arena.allocate(points);
+		return arena.at(di.first);
+	}
+
+	void Engine::push_decal(DecalInstance&& di) {
+		if (recording_list != nullptr) {
+			recording_list->instances.push_back(std::move(di));
+			return;
+		}
+		if (!clip_stack.empty()) {
+			const ClipRect& clip = clip_stack.back();
+			di.clipped = true;
+			di.clip_x1 = clip.x1; di.clip_y1 = clip.y1;
+			di.clip_x2 = clip.x2; di.clip_y2 = clip.y2;
+		}
+		layers[target_layer].decal_instances.push_back(std::move(di));
+	}
+
+	void Engine::execute_list(const RenderList& list) {
+		renderer->execute(list);
+	}
+
+	// an upright quad from p to d in screen space, corners in the order the fan expects
+	static inline void decal_quad(DecalVertex* v, const engine::float_vector_2d& p, const engine::float_vector_2d& d, const engine::float_vector_2d& uvtl, const engine::float_vector_2d& uvbr, const engine::Pixel& tint) {
+		v[0] = { { p.x, p.y }, { uvtl.x, uvtl.y }, 1.0f, tint };
+		v[1] = { { p.x, d.y }, { uvtl.x, uvbr.y }, 1.0f, tint };
+		v[2] = { { d.x, d.y }, { uvbr.x, uvbr.y }, 1.0f, tint };
+		v[3] = { { d.x, p.y }, { uvbr.x, uvtl.y }, 1.0f, tint };
+	}
+
 	void Engine::draw_partial_decal(const engine::float_vector_2d& pos, engine::Decal* decal, const engine::float_vector_2d& source_pos, const engine::float_vector_2d& source_size, const engine::float_vector_2d& scale, const engine::Pixel& tint) {
 		engine::float_vector_2d screen_space_pos = {
 			  (pos.x * inv_screen_size.x) * 2.0f - 1.0f,
@@ -1316,30 +1906,15 @@ namespace engine {
 		engine::float_vector_2d quantised_pos = ((screen_space_pos * window) + engine::float_vector_2d(0.5f, 0.5f)).floor() / window;
 		engine::float_vector_2d quantised_dim = ((screen_space_dim * window) + engine::float_vector_2d(0.5f, -0.5f)).ceil() / window;
 
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.pos = {  
-            { quantised_pos.x, quantised_pos.y }, 
-            { quantised_pos.x, quantised_dim.y }, 
-            { quantised_dim.x, quantised_dim.y }, 
-            { quantised_dim.x, quantised_pos.y } 
-        };
-
 		engine::float_vector_2d uvtl = (source_pos + engine::float_vector_2d(0.0001f, 0.0001f)) * decal->UV_scale;
 		engine::float_vector_2d uvbr = (source_pos + source_size - engine::float_vector_2d(0.0001f, 0.0001f)) * decal->UV_scale;
 
-		di.uv = { 
-            { uvtl.x, uvtl.y }, 
-            { uvtl.x, uvbr.y }, 
-            { uvbr.x, uvbr.y }, 
-            { uvbr.x, uvtl.y } 
-        };
-		di.w = { 1,1,1,1 };
+		DecalInstance di;
+		di.decal = decal;
+		decal_quad(decal_vertices(di, 4), quantised_pos, quantised_dim, uvtl, uvbr, tint);
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 	void Engine::draw_partial_decal(const engine::float_vector_2d& pos, const engine::float_vector_2d& size, engine::Decal* decal, const engine::float_vector_2d& source_pos, const engine::float_vector_2d& source_size, const engine::Pixel& tint) {
@@ -1353,25 +1928,39 @@ namespace engine {
 			screen_space_pos.y - (2.0f * size.y * inv_screen_size.y)
 		};
 
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.pos = { 
-            { screen_space_pos.x, screen_space_pos.y }, 
-            { screen_space_pos.x, screen_space_dim.y }, 
-            { screen_space_dim.x, screen_space_dim.y }, 
-            { screen_space_dim.x, screen_space_pos.y } 
-        };
-
 		engine::float_vector_2d uvtl = (source_pos) * decal->UV_scale;
 		engine::float_vector_2d uvbr = uvtl + ((source_size) * decal->UV_scale);
 
-		di.uv = { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } };
-		di.w = { 1,1,1,1 };
+		DecalInstance di;
+		di.decal = decal;
+		decal_quad(decal_vertices(di, 4), screen_space_pos, screen_space_dim, uvtl, uvbr, tint);
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
+	}
+
+	void Engine::draw_partial_decal(const engine::float_vector_2d& pos, engine::Atlas& atlas, int32_t region, const engine::float_vector_2d& scale, const engine::Pixel& tint) {
+		if (!atlas.has_region(region))
+			return;
+		const engine::Atlas::Region& r = atlas.get_region(region);
+		atlas.update();
+		draw_partial_decal(pos, atlas.get_decal(r.page), { float(r.x), float(r.y) }, { float(r.w), float(r.h) }, scale, tint);
+	}
+
+	void Engine::draw_partial_decal(const engine::float_vector_2d& pos, const engine::float_vector_2d& size, engine::Atlas& atlas, int32_t region, const engine::Pixel& tint) {
+		if (!atlas.has_region(region))
+			return;
+		const engine::Atlas::Region& r = atlas.get_region(region);
+		atlas.update();
+		draw_partial_decal(pos, size, atlas.get_decal(r.page), { float(r.x), float(r.y) }, { float(r.w), float(r.h) }, tint);
+	}
+
+	void Engine::draw_partial_decal(const engine::float_vector_2d& pos, engine::Decal* decal, const engine::SpriteView& view, const engine::float_vector_2d& scale, const engine::Pixel& tint) {
+		draw_partial_decal(pos, decal, { float(view.x), float(view.y) }, { float(view.width), float(view.height) }, scale, tint);
+	}
+
+	void Engine::draw_partial_decal(const engine::float_vector_2d& pos, const engine::float_vector_2d& size, engine::Decal* decal, const engine::SpriteView& view, const engine::Pixel& tint) {
+		draw_partial_decal(pos, size, decal, { float(view.x), float(view.y) }, { float(view.width), float(view.height) }, tint);
 	}
 
 	void Engine::draw_decal(const engine::float_vector_2d& pos, engine::Decal* decal, const engine::float_vector_2d& scale, const engine::Pixel& tint) {
@@ -1387,87 +1976,46 @@ namespace engine {
 
 		DecalInstance di;
 		di.decal = decal;
-		di.points = 4;
-		di.tint = { tint, tint, tint, tint };
-		di.pos = { 
-            { screen_space_pos.x, screen_space_pos.y }, 
-            { screen_space_pos.x, screen_space_dim.y }, 
-            { screen_space_dim.x, screen_space_dim.y }, 
-            { screen_space_dim.x, screen_space_pos.y } 
-        };
-		di.uv = { 
-            { 0.0f, 0.0f}, 
-            {0.0f, 1.0f}, 
-            {1.0f, 1.0f}, 
-            {1.0f, 0.0f} 
-        };
-		di.w = { 1, 1, 1, 1 };
+		decal_quad(decal_vertices(di, 4), screen_space_pos, screen_space_dim, { 0.0f, 0.0f }, { 1.0f, 1.0f }, tint);
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 	void Engine::draw_explicit_decal(engine::Decal* decal, const engine::float_vector_2d* pos, const engine::float_vector_2d* uv, const engine::Pixel* col, uint32_t elements) {
 		DecalInstance di;
 		di.decal = decal;
-		di.pos.resize(elements);
-		di.uv.resize(elements);
-		di.w.resize(elements);
-		di.tint.resize(elements);
-		di.points = elements;
-
-		for (uint32_t i = 0; i < elements; i++) {
-			di.pos[i] = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
-			di.uv[i] = uv[i];
-			di.tint[i] = col[i];
-			di.w[i] = 1.0f;
-		}
+		DecalVertex* v = decal_vertices(di, elements);
+		for (uint32_t i = 0; i < elements; i++)
+			v[i] = { { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f }, uv[i], 1.0f, col[i] };
 
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 	void Engine::draw_polygon_decal(engine::Decal* decal, const std::vector<engine::float_vector_2d>& pos, const std::vector<engine::float_vector_2d>& uv, const engine::Pixel tint) {
 		DecalInstance di;
 		di.decal = decal;
-		di.points = uint32_t(pos.size());
-		di.pos.resize(di.points);
-		di.uv.resize(di.points);
-		di.w.resize(di.points);
-		di.tint.resize(di.points);
-
-		for (uint32_t i = 0; i < di.points; i++) {
-			di.pos[i] = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
-			di.uv[i] = uv[i];
-			di.tint[i] = tint;
-			di.w[i] = 1.0f;
-		}
+		DecalVertex* v = decal_vertices(di, uint32_t(pos.size()));
+		for (uint32_t i = 0; i < di.points; i++)
+			v[i] = { { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f }, uv[i], 1.0f, tint };
 
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 	void Engine::draw_polygon_decal(engine::Decal* decal, const std::vector<engine::float_vector_2d>& pos, const std::vector<engine::float_vector_2d>& uv, const std::vector<engine::Pixel> &tint) {
 		DecalInstance di;
 		di.decal = decal;
-		di.points = uint32_t(pos.size());
-		di.pos.resize(di.points);
-		di.uv.resize(di.points);
-		di.w.resize(di.points);
-		di.tint.resize(di.points);
-
-		for (uint32_t i = 0; i < di.points; i++) {
-			di.pos[i] = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
-			di.uv[i] = uv[i];
-			di.tint[i] = tint[i];
-			di.w[i] = 1.0f;
-		}
+		DecalVertex* v = decal_vertices(di, uint32_t(pos.size()));
+		for (uint32_t i = 0; i < di.points; i++)
+			v[i] = { { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f }, uv[i], 1.0f, tint[i] };
 
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 	void Engine::draw_polygon_decal(engine::Decal* decal, const std::vector<engine::float_vector_2d>& pos, const std::vector<engine::float_vector_2d>& uv, const std::vector<engine::Pixel>& colors, const engine::Pixel tint) {
@@ -1479,43 +2027,25 @@ namespace engine {
 	void Engine::draw_polygon_decal(engine::Decal* decal, const std::vector<engine::float_vector_2d>& pos, const std::vector<float>& depth, const std::vector<engine::float_vector_2d>& uv, const engine::Pixel tint) {
 		DecalInstance di;
 		di.decal = decal;
-		di.points = uint32_t(pos.size());
-		di.pos.resize(di.points);
-		di.uv.resize(di.points);
-		di.w.resize(di.points);
-		di.tint.resize(di.points);
-
-		for (uint32_t i = 0; i < di.points; i++) {
-			di.pos[i] = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
-			di.uv[i] = uv[i];
-			di.tint[i] = tint;
-			di.w[i] = 1.0f;
-		}
+		DecalVertex* v = decal_vertices(di, uint32_t(pos.size()));
+		for (uint32_t i = 0; i < di.points; i++)
+			v[i] = { { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f }, uv[i], 1.0f, tint };
 
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 #ifdef ENGINE_ENABLE_EXPERIMENTAL
 	void Engine::LW3D_DrawTriangles(engine::Decal* decal, const std::vector<std::array<float, 3>>& pos, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& col) {
 		DecalInstance di;
 		di.decal = decal;
-		di.points = uint32_t(pos.size());
-		di.pos.resize(di.points);
-		di.uv.resize(di.points);
-		di.w.resize(di.points);
-		di.tint.resize(di.points);
-
-		for (uint32_t i = 0; i < di.points; i++) {
-			di.pos[i] = { pos[i][0], pos[i][1] };
-			di.w[i] = pos[i][2];
-			di.uv[i] = tex[i];
-			di.tint[i] = col[i];			
-		}
+		DecalVertex* v = decal_vertices(di, uint32_t(pos.size()));
+		for (uint32_t i = 0; i < di.points; i++)
+			v[i] = { { pos[i][0], pos[i][1] }, tex[i], pos[i][2], col[i] };
 
 		di.mode = DecalMode::MODEL3D;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 #endif
 
@@ -1555,72 +2085,53 @@ namespace engine {
 	void Engine::draw_rotated_decal(const engine::float_vector_2d& pos, engine::Decal* decal, const float angle, const engine::float_vector_2d& center, const engine::float_vector_2d& scale, const engine::Pixel& tint) {
 		DecalInstance di;
 		di.decal = decal;
-		di.pos.resize(4);
-		di.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
-		di.w = { 1, 1, 1, 1 };
-		di.tint = { tint, tint, tint, tint };
-		di.points = 4;
-		di.pos[0] = (engine::float_vector_2d(0.0f, 0.0f) - center) * scale;
-		di.pos[1] = (engine::float_vector_2d(0.0f, float(decal->sprite->height)) - center) * scale;
-		di.pos[2] = (engine::float_vector_2d(float(decal->sprite->width), float(decal->sprite->height)) - center) * scale;
-		di.pos[3] = (engine::float_vector_2d(float(decal->sprite->width), 0.0f) - center) * scale;
+		DecalVertex* v = decal_vertices(di, 4);
+		decal_quad(v, (engine::float_vector_2d(0.0f, 0.0f) - center) * scale, (engine::float_vector_2d(float(decal->sprite->width), float(decal->sprite->height)) - center) * scale, { 0.0f, 0.0f }, { 1.0f, 1.0f }, tint);
 		float c = cos(angle), s = sin(angle);
 
 		for (int i = 0; i < 4; i++) {
-			di.pos[i] = pos + engine::float_vector_2d(di.pos[i].x * c - di.pos[i].y * s, di.pos[i].x * s + di.pos[i].y * c);
-			di.pos[i] = di.pos[i] * inv_screen_size * 2.0f - engine::float_vector_2d(1.0f, 1.0f);
-			di.pos[i].y *= -1.0f;
-			di.w[i] = 1;
+			v[i].pos = pos + engine::float_vector_2d(v[i].pos.x * c - v[i].pos.y * s, v[i].pos.x * s + v[i].pos.y * c);
+			v[i].pos = v[i].pos * inv_screen_size * 2.0f - engine::float_vector_2d(1.0f, 1.0f);
+			v[i].pos.y *= -1.0f;
 		}
 
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 	void Engine::draw_partial_rotated_decal(const engine::float_vector_2d& pos, engine::Decal* decal, const float angle, const engine::float_vector_2d& center, const engine::float_vector_2d& source_pos, const engine::float_vector_2d& source_size, const engine::float_vector_2d& scale, const engine::Pixel& tint) {
+		engine::float_vector_2d uvtl = source_pos * decal->UV_scale;
+		engine::float_vector_2d uvbr = uvtl + (source_size * decal->UV_scale);
+
 		DecalInstance di;
 		di.decal = decal;
-		di.points = 4;
-		di.tint = { tint, tint, tint, tint };
-		di.w = { 1, 1, 1, 1 };
-		di.pos.resize(4);
-		di.pos[0] = (engine::float_vector_2d(0.0f, 0.0f) - center) * scale;
-		di.pos[1] = (engine::float_vector_2d(0.0f, source_size.y) - center) * scale;
-		di.pos[2] = (engine::float_vector_2d(source_size.x, source_size.y) - center) * scale;
-		di.pos[3] = (engine::float_vector_2d(source_size.x, 0.0f) - center) * scale;
+		DecalVertex* v = decal_vertices(di, 4);
+		decal_quad(v, (engine::float_vector_2d(0.0f, 0.0f) - center) * scale, (source_size - center) * scale, uvtl, uvbr, tint);
 		float c = cos(angle), s = sin(angle);
 
 		for (int i = 0; i < 4; i++) {
-			di.pos[i] = pos + engine::float_vector_2d(di.pos[i].x * c - di.pos[i].y * s, di.pos[i].x * s + di.pos[i].y * c);
-			di.pos[i] = di.pos[i] * inv_screen_size * 2.0f - engine::float_vector_2d(1.0f, 1.0f);
-			di.pos[i].y *= -1.0f;
+			v[i].pos = pos + engine::float_vector_2d(v[i].pos.x * c - v[i].pos.y * s, v[i].pos.x * s + v[i].pos.y * c);
+			v[i].pos = v[i].pos * inv_screen_size * 2.0f - engine::float_vector_2d(1.0f, 1.0f);
+			v[i].pos.y *= -1.0f;
 		}
 
-		engine::float_vector_2d uvtl = source_pos * decal->UV_scale;
-		engine::float_vector_2d uvbr = uvtl + (source_size * decal->UV_scale);
-		
-        di.uv = { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } };
 		di.mode = decal_mode;
 		di.structure = decal_structure;
-		layers[target_layer].decal_instances.push_back(di);
+		push_decal(std::move(di));
 	}
 
 	void Engine::draw_partial_warped_decal(engine::Decal* decal, const engine::float_vector_2d* pos, const engine::float_vector_2d& source_pos, const engine::float_vector_2d& source_size, const engine::Pixel& tint) {
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.w = { 1, 1, 1, 1 };
-		di.pos.resize(4);
-		di.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
 		engine::float_vector_2d center;
 		float rd = ((pos[2].x - pos[0].x) * (pos[3].y - pos[1].y) - (pos[3].x - pos[1].x) * (pos[2].y - pos[0].y));
 		
         if (rd != 0) {
 			engine::float_vector_2d uvtl = source_pos * decal->UV_scale;
 			engine::float_vector_2d uvbr = uvtl + (source_size * decal->UV_scale);
-			di.uv = { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } };
+			DecalInstance di;
+			di.decal = decal;
+			DecalVertex* v = decal_vertices(di, 4);
+			decal_quad(v, {}, {}, uvtl, uvbr, tint);
 
 			rd = 1.0f / rd;
 			float rn = ((pos[3].x - pos[1].x) * (pos[0].y - pos[1].y) - (pos[3].y - pos[1].y) * (pos[0].x - pos[1].x)) * rd;
@@ -1630,30 +2141,28 @@ namespace engine {
 			
             for (int i = 0; i < 4; i++) {
 				float q = d[i] == 0.0f ? 1.0f : (d[i] + d[(i + 2) & 3]) / d[(i + 2) & 3];
-				di.uv[i] *= q; di.w[i] *= q;
-				di.pos[i] = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
+				v[i].uv *= q; v[i].w *= q;
+				v[i].pos = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
 			}
 
 			di.mode = decal_mode;
 			di.structure = decal_structure;
-			layers[target_layer].decal_instances.push_back(di);
+			push_decal(std::move(di));
 		}
 	}
 
 	void Engine::draw_warped_decal(engine::Decal* decal, const engine::float_vector_2d* pos, const engine::Pixel& tint) {
 		// ARTICLE: http://www.reedbeta.com/blog/quadrilateral-interpolation-part-1/
         
-		DecalInstance di;
-		di.points = 4;
-		di.decal = decal;
-		di.tint = { tint, tint, tint, tint };
-		di.w = { 1, 1, 1, 1 };
-		di.pos.resize(4);
-		di.uv = { { 0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f} };
 		engine::float_vector_2d center;
 		float rd = ((pos[2].x - pos[0].x) * (pos[3].y - pos[1].y) - (pos[3].x - pos[1].x) * (pos[2].y - pos[0].y));
 		
         if (rd != 0) {
+			DecalInstance di;
+			di.decal = decal;
+			DecalVertex* v = decal_vertices(di, 4);
+			decal_quad(v, {}, {}, { 0.0f, 0.0f }, { 1.0f, 1.0f }, tint);
+
 			rd = 1.0f / rd;
 			float rn = ((pos[3].x - pos[1].x) * (pos[0].y - pos[1].y) - (pos[3].y - pos[1].y) * (pos[0].x - pos[1].x)) * rd;
 			float sn = ((pos[2].x - pos[0].x) * (pos[0].y - pos[1].y) - (pos[2].y - pos[0].y) * (pos[0].x - pos[1].x)) * rd;
@@ -1662,13 +2171,13 @@ namespace engine {
 			
             for (int i = 0; i < 4; i++) {
 				float q = d[i] == 0.0f ? 1.0f : (d[i] + d[(i + 2) & 3]) / d[(i + 2) & 3];
-				di.uv[i] *= q; di.w[i] *= q;
-				di.pos[i] = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
+				v[i].uv *= q; v[i].w *= q;
+				v[i].pos = { (pos[i].x * inv_screen_size.x) * 2.0f - 1.0f, ((pos[i].y * inv_screen_size.y) * 2.0f - 1.0f) * -1.0f };
 			}
 
 			di.mode = decal_mode;
 			di.structure = decal_structure;
-			layers[target_layer].decal_instances.push_back(di);
+			push_decal(std::move(di));
 		}
 	}
 
@@ -1689,110 +2198,185 @@ namespace engine {
     }
 
 	void Engine::draw_string_decal(const engine::float_vector_2d& pos, const std::string& text, const Pixel col, const engine::float_vector_2d& scale) {
-		engine::float_vector_2d spos = { 0.0f, 0.0f };
-		for (auto c : text) {
-			if (c == '\n') {
-				spos.x = 0; 
-                spos.y += 8.0f * scale.y;
-			}
-			else if (c == '\t') {
-				spos.x += 8.0f * float(tab_size_in_spaces) * scale.x;
-			}
-			else {
-				int32_t ox = (c - 32) % 16;
-				int32_t oy = (c - 32) / 16;
-				
-                draw_partial_decal(pos + spos, font_renderable.Decal(), {float(ox) * 8.0f, float(oy) * 8.0f}, {8.0f, 8.0f}, scale, col);
-				spos.x += 8.0f * scale.x;
-			}
-		}
+		push_string_decal(pos, text, col, scale, false);
 	}
 
 	void Engine::draw_string_prop_decal(const engine::float_vector_2d& pos, const std::string& text, const Pixel col, const engine::float_vector_2d& scale) {
-		engine::float_vector_2d spos = { 0.0f, 0.0f };
-		for (auto c : text) {
-			if (c == '\n') {
-				spos.x = 0; 
-                spos.y += 8.0f * scale.y;
-			}
-			else if (c == '\t') {
-				spos.x += 8.0f * float(tab_size_in_spaces) * scale.x;
-			}
-			else {
-				int32_t ox = (c - 32) % 16;
-				int32_t oy = (c - 32) / 16;
-				draw_partial_decal(pos + spos, font_renderable.Decal(), { float(ox) * 8.0f + float(font_spacing[c - 32].x), float(oy) * 8.0f }, { float(font_spacing[c - 32].y), 8.0f }, scale, col);
-				spos.x += float(font_spacing[c - 32].y) * scale.x;
-			}
-		}
+		push_string_decal(pos, text, col, scale, true);
 	}
 
 	void Engine::draw_rotated_string_decal(const engine::float_vector_2d& pos, const std::string& text, const float angle, const engine::float_vector_2d& center, const Pixel col, const engine::float_vector_2d& scale) {
-		engine::float_vector_2d spos = center;
-		for (auto c : text) {
-			if (c == '\n') {
-				spos.x = center.x; spos.y -= 8.0f;
-			}
-			else if (c == '\t') {
-				spos.x += 8.0f * float(tab_size_in_spaces) * scale.x;
-			}
-			else {
-				int32_t ox = (c - 32) % 16;
-				int32_t oy = (c - 32) / 16;
-				draw_partial_rotated_decal(pos, font_renderable.Decal(), angle, spos, { float(ox) * 8.0f, float(oy) * 8.0f }, { 8.0f, 8.0f }, scale, col);
-				spos.x -= 8.0f;
-			}
-		}
+		push_rotated_string_decal(pos, text, angle, center, col, scale, false);
 	}
 
 	void Engine::draw_rotated_string_prop_decal(const engine::float_vector_2d& pos, const std::string& text, const float angle, const engine::float_vector_2d& center, const Pixel col, const engine::float_vector_2d& scale) {
-		engine::float_vector_2d spos = center;
-		for (auto c : text) {
-			if (c == '\n') {
-				spos.x = center.x; spos.y -= 8.0f;
-			}
-			else if (c == '\t') {
-				spos.x += 8.0f * float(tab_size_in_spaces) * scale.x;
-			}
-			else {
-				int32_t ox = (c - 32) % 16;
-				int32_t oy = (c - 32) / 16;
-				draw_partial_rotated_decal(pos, font_renderable.Decal(), angle, spos, { float(ox) * 8.0f + float(font_spacing[c - 32].x), float(oy) * 8.0f }, { float(font_spacing[c - 32].y), 8.0f }, scale, col);
-				spos.x -= float(font_spacing[c - 32].y);
+		push_rotated_string_decal(pos, text, angle, center, col, scale, true);
+	}
+
+	// The whole string is one triangle list against the font decal. Each glyph is
+	// quantised to the window the same way draw_partial_decal quantises a decal.
+	void Engine::push_string_decal(const engine::float_vector_2d& pos, const std::string& text, const Pixel col, const engine::float_vector_2d& scale, bool prop) {
+		glyphs.update(font_renderable.Sprite(), font_spacing);
+		const GlyphCache::TextMesh& mesh = glyphs.text_mesh(text, prop, scale, col, font_renderable.Decal()->UV_scale);
+		if (mesh.uv.empty())
+			return;
+
+		DecalInstance di;
+		di.decal = font_renderable.Decal();
+		di.mode = decal_mode;
+		di.structure = engine::DecalStructure::LIST;
+		DecalVertex* v = decal_vertices(di, uint32_t(mesh.uv.size()));
+		for (uint32_t i = 0; i < di.points; i++)
+			v[i] = { {}, mesh.uv[i], mesh.w[i], mesh.tint[i] };
+
+		engine::float_vector_2d window = engine::float_vector_2d(view_size);
+		for (size_t q = 0; q < mesh.quads.size(); q += 2) {
+			engine::float_vector_2d tl = pos + mesh.quads[q], br = pos + mesh.quads[q + 1];
+			engine::float_vector_2d screen_space_pos = { (tl.x * inv_screen_size.x) * 2.0f - 1.0f, -((tl.y * inv_screen_size.y) * 2.0f - 1.0f) };
+			engine::float_vector_2d screen_space_dim = { (br.x * inv_screen_size.x) * 2.0f - 1.0f, -((br.y * inv_screen_size.y) * 2.0f - 1.0f) };
+			engine::float_vector_2d p = ((screen_space_pos * window) + engine::float_vector_2d(0.5f, 0.5f)).floor() / window;
+			engine::float_vector_2d d = ((screen_space_dim * window) + engine::float_vector_2d(0.5f, -0.5f)).ceil() / window;
+
+			DecalVertex* g = v + q * 3;
+			g[0].pos = { p.x, p.y }; g[1].pos = { p.x, d.y }; g[2].pos = { d.x, d.y };
+			g[3].pos = { p.x, p.y }; g[4].pos = { d.x, d.y }; g[5].pos = { d.x, p.y };
+		}
+		push_decal(std::move(di));
+	}
+
+	void Engine::push_rotated_string_decal(const engine::float_vector_2d& pos, const std::string& text, const float angle, const engine::float_vector_2d& center, const Pixel col, const engine::float_vector_2d& scale, bool prop) {
+		glyphs.update(font_renderable.Sprite(), font_spacing);
+		const GlyphCache::TextMesh& mesh = glyphs.text_mesh(text, prop, scale, col, font_renderable.Decal()->UV_scale);
+		if (mesh.uv.empty())
+			return;
+
+		DecalInstance di;
+		di.decal = font_renderable.Decal();
+		di.mode = decal_mode;
+		di.structure = engine::DecalStructure::LIST;
+		DecalVertex* v = decal_vertices(di, uint32_t(mesh.uv.size()));
+		for (uint32_t i = 0; i < di.points; i++)
+			v[i] = { {}, mesh.uv[i], mesh.w[i], mesh.tint[i] };
+
+		float c = cos(angle), s = sin(angle);
+		auto place = [&](const engine::float_vector_2d& l) {
+			engine::float_vector_2d r = l - center * scale;
+			r = pos + engine::float_vector_2d(r.x * c - r.y * s, r.x * s + r.y * c);
+			r = r * inv_screen_size * 2.0f - engine::float_vector_2d(1.0f, 1.0f);
+			r.y *= -1.0f;
+			return r;
+		};
+
+		for (size_t q = 0; q < mesh.quads.size(); q += 2) {
+			const engine::float_vector_2d& tl = mesh.quads[q], & br = mesh.quads[q + 1];
+			DecalVertex* g = v + q * 3;
+			g[0].pos = place(tl); g[1].pos = place({ tl.x, br.y }); g[2].pos = place(br); g[5].pos = place({ br.x, tl.y });
+			g[3].pos = g[0].pos; g[4].pos = g[2].pos;
+		}
+		push_decal(std::move(di));
+	}
+
+	void Engine::begin_decal_list(engine::DecalList& list) {
+		list.instances.clear();
+		list.arena.reset();
+		recording_list = &list;
+	}
+
+	void Engine::end_decal_list() {
+		if (recording_list == nullptr)
+			return;
+		recording_list->revision++;
+		recording_list->valid = true;
+		recording_list = nullptr;
+	}
+
+	void Engine::draw_decal_list(engine::DecalList& list) {
+		if (recording_list == &list || !list.valid)
+			return;
+
+		// a list drawn while recording another is copied into it
+		if (recording_list != nullptr) {
+			for (const DecalInstance& i : list.instances) {
+				DecalInstance di = i;
+				DecalVertex* v = decal_vertices(di, i.points);
+				std::copy_n(list.arena.at(i.first), i.points, v);
+				push_decal(std::move(di));
 			}
+			return;
 		}
+
+		DecalInstance di;
+		di.list = &list;
+		push_decal(std::move(di));
 	}
 
-	engine::int_vector_2d Engine::get_text_size(const std::string& s)
-	{
-		engine::int_vector_2d size = { 0,1 };
-		engine::int_vector_2d pos = { 0,1 };
-		for (auto c : s) {
-			if (c == '\n') { 
-                pos.y++; 
-                pos.x = 0; 
-            }
-			else if (c == '\t') { pos.x += tab_size_in_spaces; }
-			else pos.x++;
-			size.x = std::max(size.x, pos.x);
-			size.y = std::max(size.y, pos.y);
+	// Retained lists keep vertices and wireframe draws the edges of each triangle, so both take the
+	// quads expanded on the CPU, as does any renderer that cannot instance. The expansion matches draw_partial_rotated_decal.
+	void Engine::draw_sprite_batch(engine::Decal* decal, const engine::SpriteQuad* quads, uint32_t count) {
+		if (decal == nullptr || count == 0)
+			return;
+
+		DecalInstance di;
+		di.decal = decal;
+		di.mode = decal_mode;
+		if (recording_list == nullptr && decal_mode != DecalMode::WIREFRAME && renderer->supports_instancing()) {
+			di.first = uint32_t(sprite_quads.size());
+			di.quads = count;
+			sprite_quads.insert(sprite_quads.end(), quads, quads + count);
+			push_decal(std::move(di));
+			return;
 		}
-		return size * 8;
+
+		di.structure = engine::DecalStructure::LIST;
+		DecalVertex* v = decal_vertices(di, count * 6);
+		for (uint32_t i = 0; i < count; i++, v += 6) {
+			const engine::SpriteQuad& q = quads[i];
+			float c = std::cos(q.angle), s = std::sin(q.angle);
+			auto place = [&](float x, float y) {
+				float lx = (x - q.center.x) * q.scale.x, ly = (y - q.center.y) * q.scale.y;
+				return engine::float_vector_2d((q.pos.x + lx * c - ly * s) * inv_screen_size.x * 2.0f - 1.0f, 1.0f - (q.pos.y + lx * s + ly * c) * inv_screen_size.y * 2.0f);
+			};
+			engine::float_vector_2d uvtl = q.source_pos * decal->UV_scale;
+			engine::float_vector_2d uvbr = (q.source_pos + q.source_size) * decal->UV_scale;
+			v[0] = { place(0.0f, 0.0f), uvtl, 1.0f, q.tint };
+			v[1] = { place(0.0f, q.source_size.y), { uvtl.x, uvbr.y }, 1.0f, q.tint };
+			v[2] = { place(q.source_size.x, q.source_size.y), uvbr, 1.0f, q.tint };
+			v[3] = v[0];
+			v[4] = v[2];
+			v[5] = { place(q.source_size.x, 0.0f), { uvbr.x, uvtl.y }, 1.0f, q.tint };
+		}
+		push_decal(std::move(di));
+	}
+
+	void Engine::draw_sprite_batch(engine::Decal* decal, const std::vector<engine::SpriteQuad>& quads) {
+		draw_sprite_batch(decal, quads.data(), uint32_t(quads.size()));
 	}
 
+	engine::int_vector_2d Engine::get_text_size(const std::string& s) { return glyphs.text_size(s, false); }
+
 	void Engine::draw_string(const engine::int_vector_2d& pos, const std::string& text, Pixel col, uint32_t scale) { 
         draw_string(pos.x, pos.y, text, col, scale); 
     }
 
 	void Engine::draw_string(int32_t x, int32_t y, const std::string& text, Pixel col, uint32_t scale) {
-		int32_t sx = 0;
-		int32_t sy = 0;
 		Pixel::Mode m = pixel_mode;
+		if (m != Pixel::CUSTOM)
+			m = (col.a != 255) ? Pixel::ALPHA : Pixel::MASK;
 
-		if (m != Pixel::CUSTOM) {
-			if (col.a != 255)		set_pixel_mode(Pixel::ALPHA);
-			else					set_pixel_mode(Pixel::MASK);
-		}
+		glyphs.update(font_renderable.Sprite(), font_spacing);
+		glyphs.prepare(scale);
+
+		DrawCommand c(DrawCommand::STRING, m, blend_fixed, col);
+		c.v[0] = x; c.v[1] = y;
+		c.flags = scale;
+		c.text = &text;
+		submit(c);
+	}
+
+	template<Pixel::Mode M>
+	void Engine::raster_string(const Raster& r, int32_t x, int32_t y, const std::string& text, Pixel col, uint32_t scale, bool prop) {
+		int32_t sx = 0;
+		int32_t sy = 0;
 
 		for (auto c : text) {
 			if (c == '\n') {
@@ -1802,90 +2386,61 @@ namespace engine {
 				sx += 8 * tab_size_in_spaces * scale;
 			}
 			else {
-				int32_t ox = (c - 32) % 16;
-				int32_t oy = (c - 32) / 16;
-
-				if (scale > 1) {
-					for (uint32_t i = 0; i < 8; i++)
-						for (uint32_t j = 0; j < 8; j++)
-							if (font_renderable.Sprite()->get_pixel(i + ox * 8, j + oy * 8).r > 0)
-								for (uint32_t is = 0; is < scale; is++)
-									for (uint32_t js = 0; js < scale; js++)
-										draw(x + sx + (i * scale) + is, y + sy + (j * scale) + js, col);
-				}
-				else {
-					for (uint32_t i = 0; i < 8; i++)
-						for (uint32_t j = 0; j < 8; j++)
-							if (font_renderable.Sprite()->get_pixel(i + ox * 8, j + oy * 8).r > 0)
-								draw(x + sx + i, y + sy + j, col);
-				}
-				sx += 8 * scale;
+				int32_t g = GlyphCache::glyph_of(c);
+				raster_glyph<M>(r, x + sx, y + sy, g, prop, col, scale);
+				sx += glyphs.get_width(g, prop) * scale;
 			}
 		}
-		set_pixel_mode(m);
 	}
 
-	engine::int_vector_2d Engine::get_text_size_prop(const std::string& s) {
-		engine::int_vector_2d size = { 0,1 };
-		engine::int_vector_2d pos = { 0,1 };
-		for (auto c : s) {
-			if (c == '\n') { 
-                pos.y += 1;
-                pos.x = 0; 
-            }
-			else if (c == '\t') { pos.x += tab_size_in_spaces * 8; }
-			else pos.x += font_spacing[c - 32].y;
-			size.x = std::max(size.x, pos.x);
-			size.y = std::max(size.y, pos.y);
+	template<Pixel::Mode M>
+	void Engine::raster_glyph(const Raster& r, int32_t x, int32_t y, int32_t glyph, bool prop, Pixel col, uint32_t scale) {
+		int32_t s = int32_t(scale);
+		if (glyph < 0 || x >= r.clip_x2 || y >= r.clip_y2 || x + glyphs.get_width(glyph, prop) * s <= r.clip_x1 || y + 8 * s <= r.clip_y1)
+			return;
+
+		int32_t count = 0;
+		const GlyphCache::Run* run = glyphs.get_runs(glyph, prop, scale, count);
+		if (run != nullptr) {
+			for (int32_t i = 0; i < count; i++)
+				r.span<M>(x + run[i].x1, x + run[i].x2, y + run[i].y, col);
+			return;
 		}
 
-		size.y *= 8;
-		return size;
+		// scales without prepared runs find them in the mask, each run covers scale rows
+		uint64_t mask = glyphs.get_mask(glyph, prop);
+		for (int32_t j = 0; j < 8; j++) {
+			uint32_t row = uint32_t(mask >> (j * 8)) & 0xFF;
+			for (int32_t i = 0; i < 8;) {
+				if (!(row & (1u << i))) { i++; continue; }
+				int32_t end = i;
+				while (end < 8 && (row & (1u << end))) end++;
+				for (int32_t js = 0; js < s; js++)
+					r.span<M>(x + i * s, x + end * s, y + j * s + js, col);
+				i = end;
+			}
+		}
 	}
 
+	engine::int_vector_2d Engine::get_text_size_prop(const std::string& s) { return glyphs.text_size(s, true); }
+
 	void Engine::draw_string_prop(const engine::int_vector_2d& pos, const std::string& text, Pixel col, uint32_t scale) { 
         draw_string_prop(pos.x, pos.y, text, col, scale); 
     }
 
 	void Engine::draw_string_prop(int32_t x, int32_t y, const std::string& text, Pixel col, uint32_t scale) {
-		int32_t sx = 0;
-		int32_t sy = 0;
 		Pixel::Mode m = pixel_mode;
+		if (m != Pixel::CUSTOM)
+			m = (col.a != 255) ? Pixel::ALPHA : Pixel::MASK;
 
-		if (m != Pixel::CUSTOM) {
-			if (col.a != 255)		set_pixel_mode(Pixel::ALPHA);
-			else					set_pixel_mode(Pixel::MASK);
-		}
+		glyphs.update(font_renderable.Sprite(), font_spacing);
+		glyphs.prepare(scale);
 
-		for (auto c : text) {
-			if (c == '\n') {
-				sx = 0; sy += 8 * scale;
-			}
-			else if (c == '\t') {
-				sx += 8 * tab_size_in_spaces * scale;
-			}
-			else {
-				int32_t ox = (c - 32) % 16;
-				int32_t oy = (c - 32) / 16;
-
-				if (scale > 1) {
-					for (int32_t i = 0; i < font_spacing[c - 32].y; i++)
-						for (int32_t j = 0; j < 8; j++)
-							if (font_renderable.Sprite()->get_pixel(i + ox * 8 + font_spacing[c - 32].x, j + oy * 8).r > 0)
-								for (int32_t is = 0; is < int(scale); is++)
-									for (int32_t js = 0; js < int(scale); js++)
-										draw(x + sx + (i * scale) + is, y + sy + (j * scale) + js, col);
-				}
-				else {
-					for (int32_t i = 0; i < font_spacing[c - 32].y; i++)
-						for (int32_t j = 0; j < 8; j++)
-							if (font_renderable.Sprite()->get_pixel(i + ox * 8 + font_spacing[c - 32].x, j + oy * 8).r > 0)
-								draw(x + sx + i, y + sy + j, col);
-				}
-				sx += font_spacing[c - 32].y * scale;
-			}
-		}
-		set_pixel_mode(m);
+		DrawCommand c(DrawCommand::STRING_PROP, m, blend_fixed, col);
+		c.v[0] = x; c.v[1] = y;
+		c.flags = scale;
+		c.text = &text;
+		submit(c);
 	}
 
 	void Engine::set_pixel_mode(Pixel::Mode m) { 
@@ -1905,6 +2460,7 @@ namespace engine {
 		blend_factor = blend;
 		if (blend_factor < 0.0f) blend_factor = 0.0f;
 		if (blend_factor > 1.0f) blend_factor = 1.0f;
+		blend_fixed = blend_weight(blend_factor);
 	}
 
 	std::stringstream& Engine::console_out() { 
@@ -1983,8 +2539,13 @@ namespace engine {
 		gradient_fill_rect_decal({ 0,0 }, engine::float_vector_2d(screen_size), engine::pixel_float(0, 0, 0.5f, 0.5f), engine::pixel_float(0, 0, 0.25f, 0.5f), engine::pixel_float(0, 0, 0.25f, 0.5f), engine::pixel_float(0, 0, 0.25f, 0.5f));
 		
         set_decal_mode(engine::DecalMode::NORMAL);
-		for (int32_t line = 0; line < console_size.y; line++)
-			draw_string_decal(engine::float_vector_2d( 1, 1 + float(line) ) * console_character_scale * 8.0f, console_lines[line], engine::WHITE, console_character_scale);
+		// the lines are one string, so the whole history is a single cached mesh
+		std::string history;
+		for (int32_t line = 0; line < console_size.y; line++) {
+			if (line > 0) history += '\n';
+			history += console_lines[line];
+		}
+		draw_string_decal(engine::float_vector_2d(1, 1) * console_character_scale * 8.0f, history, engine::WHITE, console_character_scale);
 
 		fill_rect_decal(engine::float_vector_2d(1 + float((text_entry_get_cursor() + 1)), 1 + float((console_size.y - 1))) * console_character_scale * 8.0f, engine::float_vector_2d(8, 8) * console_character_scale, engine::BLACK); // TODO: Add DARK_CYAN
 		draw_string_decal(engine::float_vector_2d(1, 1 + float((console_size.y - 1))) * console_character_scale * 8.0f, std::string(">") + text_entry_get_string(), engine::WHITE, console_character_scale); // TODO: Add YELLOW
@@ -2286,37 +2847,76 @@ namespace engine {
 			update_console();
 		}
 
-		renderer->update_viewport(view_pos, view_size);
-		renderer->clear_buffer(engine::BLACK, true);
+		flush_draw();
+
+		// the frame is recorded into one list for the renderer, split at layer hooks; layer textures are uploaded on the way
+		render_list.reset();
+		render_list.inv_screen_size = inv_screen_size;
+		render_list.viewport(view_pos, view_size);
+		render_list.clear_buffer(engine::BLACK, true);
 
 		layers[0].update = true;
 		layers[0].show = true;
 		set_decal_mode(DecalMode::NORMAL);
-		renderer->prepare_drawing();
 
 		for (auto layer = layers.rbegin(); layer != layers.rend(); ++layer) {
 			if (layer->show) {
 				if (layer->func_hook == nullptr) {
-					renderer->apply_texture(layer->draw_target.Decal()->id);
 					if (!suspend_texture_transfer && layer->update) {
 						layer->draw_target.Decal()->update();
 						layer->update = false;
 					}
 
-					renderer->draw_layer_quad(layer->offset, layer->scale, layer->tint);
-
-					for (auto& decal : layer->decal_instances)
-						renderer->draw_decal(decal);
-					layer->decal_instances.clear();
+					render_list.layer(layer->draw_target.Decal()->id, layer->offset, layer->scale, layer->tint);
+
+					// consecutive decals with the same clip rectangle share one scissor change
+					const DecalInstance* scissor = nullptr;
+					for (auto& decal : layer->decal_instances) {
+						bool changed = (scissor == nullptr) ? decal.clipped : (decal.clipped != scissor->clipped || (decal.clipped &&
+							(decal.clip_x1 != scissor->clip_x1 || decal.clip_y1 != scissor->clip_y1 || decal.clip_x2 != scissor->clip_x2 || decal.clip_y2 != scissor->clip_y2)));
+						if (changed) {
+							if (!decal.clipped)
+								render_list.scissor({ 0, 0 }, { 0, 0 });
+							else {
+								// screen pixels to window pixels, whose rows count up from the bottom
+								int32_t x1 = view_pos.x + decal.clip_x1 * view_size.x / screen_size.x;
+								int32_t x2 = view_pos.x + decal.clip_x2 * view_size.x / screen_size.x;
+								int32_t y1 = view_pos.y + (screen_size.y - decal.clip_y2) * view_size.y / screen_size.y;
+								int32_t y2 = view_pos.y + (screen_size.y - decal.clip_y1) * view_size.y / screen_size.y;
+								render_list.scissor({ x1, y1 }, { std::max(x2 - x1, 1), std::max(y2 - y1, 1) });
+							}
+						}
+						scissor = &decal;
+						if (decal.clipped && (decal.clip_x1 >= decal.clip_x2 || decal.clip_y1 >= decal.clip_y2))
+							continue;
+						if (decal.list != nullptr)
+							render_list.decal_list(*decal.list);
+						else if (decal.quads != 0)
+							render_list.sprite_batch(decal, sprite_quads.data() + decal.first, decal.quads);
+						else
+							render_list.decal(decal, decal_arena.at(decal.first));
+					}
+					if (scissor != nullptr && scissor->clipped)
+						render_list.scissor({ 0, 0 }, { 0, 0 });
 				}
 				else {
+					// the hook runs between lists, so what it draws onto layers still to come is drawn this frame
+					execute_list(render_list);
+					render_list.reset();
 					layer->func_hook();
 				}
 			}
 		}
 
+		execute_list(render_list);
 		renderer->display_frame();
 
+		// decals on hidden or hooked layers are dropped too, their vertices go with the arena
+		for (auto& layer : layers)
+			layer.decal_instances.clear();
+		decal_arena.reset();
+		sprite_quads.clear();
+
 		frame_timer += elapsed_time;
 		frame_count++;
 		if (frame_timer >= 1.0f) {
@@ -2379,6 +2979,7 @@ namespace engine {
 			0x17,0x17,0x17,0x17,0x07,0x17,0x17,0x18,0x18,0x17,0x17,0x07,0x33,0x07,0x08,0x00, } };
 
 		for (auto c : spacing) font_spacing.push_back({ c >> 4, c & 15 });
+		glyphs.update(font_renderable.Sprite(), font_spacing);
 
 #ifdef ENGINE_KEYBOARD_UK
 		keyboard = {
@@ -2432,17 +3033,16 @@ namespace engine {
 		virtual engine::Code create_device(std::vector<void*> params, bool fullscreen, bool VSYNC) { return engine::Code::OK; }
 		virtual engine::Code destroy_device() { return engine::Code::OK; }
 		virtual void         display_frame() {}
-		virtual void         prepare_drawing() {}
-		virtual void	     set_decal_mode(const engine::DecalMode& mode) {}
-		virtual void         draw_layer_quad(const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, const engine::Pixel tint) {}
-		virtual void         draw_decal(const engine::DecalInstance& decal) {}
+		virtual void         execute(const engine::RenderList& list) {}
+		virtual void         delete_decal_list(uint32_t id) {}
+		virtual bool         supports_instancing() { return false; }
 		virtual uint32_t     create_texture(const uint32_t width, const uint32_t height, const bool filtered = false, const bool clamp = true) {return 1;};
 		virtual void         update_texture(uint32_t id, engine::Sprite* spr) {}
+		virtual void         update_texture_region(uint32_t id, engine::Sprite* spr, int32_t x, int32_t y, int32_t w, int32_t h) {}
 		virtual void         read_texture(uint32_t id, engine::Sprite* spr) {}
 		virtual uint32_t     delete_texture(const uint32_t id) {return 1;}
 		virtual void         apply_texture(uint32_t id) {}
 		virtual void         update_viewport(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) {}
-		virtual void         clear_buffer(engine::Pixel p, bool depth) {}
 	};
 #endif
 
@@ -2488,9 +3088,9 @@ namespace engine {
 			}
 
 			if (!bytes) return engine::Code::FAIL;
-			spr->width = w; spr->height = h;
-			spr->col_data.resize(spr->width * spr->height);
-			std::memcpy(spr->col_data.data(), bytes, spr->width * spr->height * 4);
+			spr->resize(w, h);
+			for (int y = 0; y < h; y++)
+				std::memcpy(spr->col_data.data() + y * spr->pitch, bytes + y * w * 4, w * 4);
 			delete[] bytes;
 			return engine::Code::OK;
 		}
@@ -2554,6 +3154,7 @@ namespace engine {
 
 		bool sync = false;
 		engine::DecalMode decal_mode = engine::DecalMode(-1);
+		uint32_t bound_texture = uint32_t(-1);
 		engine::DecalStructure decal_structure = engine::DecalStructure(-1);
 #if defined(ENGINE_PLATFORM_X11)
 		X11::Display* engine_Display = nullptr;
@@ -2673,9 +3274,40 @@ namespace engine {
 #endif
 		}
 
-		void prepare_drawing() override {
+		void execute(const engine::RenderList& list) override {
+			prepare_drawing();
+			for (const engine::RenderCommand& c : list.commands) {
+				switch (c.type) {
+				case engine::RenderCommand::VIEWPORT:
+					update_viewport({ c.rect[0], c.rect[1] }, { c.rect[2], c.rect[3] });
+					break;
+				case engine::RenderCommand::SCISSOR:
+					update_scissor({ c.rect[0], c.rect[1] }, { c.rect[2], c.rect[3] });
+					break;
+				case engine::RenderCommand::CLEAR:
+					clear_buffer(c.col, c.count != 0);
+					break;
+				case engine::RenderCommand::LAYER:
+					bind_texture(c.texture);
+					draw_layer_quad({ c.transform[0], c.transform[1] }, { c.transform[2], c.transform[3] }, c.col);
+					break;
+				case engine::RenderCommand::DECAL:
+					draw_decal(*c.decal, c.vertices);
+					break;
+				case engine::RenderCommand::DECAL_LIST:
+					for (const engine::DecalInstance& decal : c.list->instances)
+						draw_decal(decal, c.list->arena.at(decal.first));
+					break;
+				default:
+					break;
+				}
+			}
+		}
+
+		void prepare_drawing() {
 			glEnable(GL_BLEND);
 			decal_mode = DecalMode::NORMAL;
+			bound_texture = uint32_t(-1);
 			decal_structure = DecalStructure::FAN;
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		}
@@ -2708,7 +3340,7 @@ namespace engine {
 			}
 		}
 
-		void draw_layer_quad(const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, const engine::Pixel tint) override {
+		void draw_layer_quad(const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, const engine::Pixel tint) {
 			glBegin(GL_QUADS);
 			glColor4ub(tint.r, tint.g, tint.b, tint.a);
 			glTexCoord2f(0.0f * scale.x + offset.x, 1.0f * scale.y + offset.y);
@@ -2722,13 +3354,10 @@ namespace engine {
 			glEnd();
 		}
 
-		void draw_decal(const engine::DecalInstance& decal) override {
+		void draw_decal(const engine::DecalInstance& decal, const engine::DecalVertex* vertices) {
 			set_decal_mode(decal.mode);
 
-			if (decal.decal == nullptr)
-				glBindTexture(GL_TEXTURE_2D, 0);
-			else
-				glBindTexture(GL_TEXTURE_2D, decal.decal->id);
+			bind_texture((decal.decal == nullptr) ? 0 : decal.decal->id);
 			
 			if (decal_mode == DecalMode::MODEL3D) {
 #ifdef ENGINE_ENABLE_EXPERIMENTAL
@@ -2753,9 +3382,10 @@ namespace engine {
 				glBegin(GL_TRIANGLES);
 				
 				for (uint32_t n = 0; n < decal.points; n++) {
-					glColor4ub(decal.tint[n].r, decal.tint[n].g, decal.tint[n].b, decal.tint[n].a);
-					glTexCoord2f(decal.uv[n].x, decal.uv[n].y);
-					glVertex3f(decal.pos[n].x, decal.pos[n].y, decal.w[n]);
+					const engine::DecalVertex& v = vertices[n];
+					glColor4ub(v.tint.r, v.tint.g, v.tint.b, v.tint.a);
+					glTexCoord2f(v.uv.x, v.uv.y);
+					glVertex3f(v.pos.x, v.pos.y, v.w);
 				}
 
 				glEnd();
@@ -2766,7 +3396,11 @@ namespace engine {
 #endif
 			}
 			else {
-				if (decal_mode == DecalMode::WIREFRAME)
+				// wireframe outlines each triangle, a list may hold many unrelated ones
+				bool outline = decal_mode == DecalMode::WIREFRAME && decal.structure != engine::DecalStructure::LINE;
+				if (outline)
+					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+				if (decal_mode == DecalMode::WIREFRAME && !outline)
 					glBegin(GL_LINE_LOOP);
 				else {
 					if(decal.structure == engine::DecalStructure::FAN)
@@ -2778,21 +3412,30 @@ namespace engine {
 				}
 
 				for (uint32_t n = 0; n < decal.points; n++) {
-					glColor4ub(decal.tint[n].r, decal.tint[n].g, decal.tint[n].b, decal.tint[n].a);
-					glTexCoord4f(decal.uv[n].x, decal.uv[n].y, 0.0f, decal.w[n]);
-					glVertex2f(decal.pos[n].x, decal.pos[n].y);
+					const engine::DecalVertex& v = vertices[n];
+					glColor4ub(v.tint.r, v.tint.g, v.tint.b, v.tint.a);
+					glTexCoord4f(v.uv.x, v.uv.y, 0.0f, v.w);
+					glVertex2f(v.pos.x, v.pos.y);
 				}
 				glEnd();
+				if (outline)
+					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 			}
 
 		}
 
+		void delete_decal_list(uint32_t id) override { UNUSED(id); }
+
+		// fixed function has no instancing, the engine expands batches before they are recorded
+		bool supports_instancing() override { return false; }
+
 		uint32_t create_texture(const uint32_t width, const uint32_t height, const bool filtered, const bool clamp) override {
 			UNUSED(width);
 			UNUSED(height);
 			uint32_t id = 0;
 			glGenTextures(1, &id);
 			glBindTexture(GL_TEXTURE_2D, id);
+			bound_texture = id;
 			if (filtered) {
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -2817,23 +3460,43 @@ namespace engine {
 
 		uint32_t delete_texture(const uint32_t id) override {
 			glDeleteTextures(1, &id);
+			if (id == bound_texture) bound_texture = 0;
 			return id;
 		}
 
 		void update_texture(uint32_t id, engine::Sprite* spr) override {
 			UNUSED(id);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->get_data());
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->pitch);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->col_data.data());
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
+
+		void update_texture_region(uint32_t id, engine::Sprite* spr, int32_t x, int32_t y, int32_t w, int32_t h) override {
+			UNUSED(id);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->pitch);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, spr->col_data.data() + y * spr->pitch + x);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 		}
 
 		void read_texture(uint32_t id, engine::Sprite* spr) override {
+			glPixelStorei(GL_PACK_ROW_LENGTH, spr->pitch);
 			glReadPixels(0, 0, spr->width, spr->height, GL_RGBA, GL_UNSIGNED_BYTE, spr->get_data());
+			glPixelStorei(GL_PACK_ROW_LENGTH, 0);
 		}
 
 		void apply_texture(uint32_t id) override {
-			glBindTexture(GL_TEXTURE_2D, id);
+			bind_texture(id);
 		}
 
-		void clear_buffer(engine::Pixel p, bool depth) override {
+		// tiles drawn from one atlas page share a texture, so most binds are redundant
+		void bind_texture(uint32_t id) {
+			if (id != bound_texture) {
+				glBindTexture(GL_TEXTURE_2D, id);
+				bound_texture = id;
+			}
+		}
+
+		void clear_buffer(engine::Pixel p, bool depth) {
 			glClearColor(float(p.r) / 255.0f, float(p.g) / 255.0f, float(p.b) / 255.0f, float(p.a) / 255.0f);
 			glClear(GL_COLOR_BUFFER_BIT);
 			if (depth) glClear(GL_DEPTH_BUFFER_BIT);
@@ -2842,6 +3505,15 @@ namespace engine {
 		void update_viewport(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) override {
 			glViewport(pos.x, pos.y, size.x, size.y);
 		}
+
+		void update_scissor(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) {
+			if (size.x <= 0 || size.y <= 0) {
+				glDisable(GL_SCISSOR_TEST);
+				return;
+			}
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(pos.x, pos.y, size.x, size.y);
+		}
 	};
 }
 #endif
@@ -2887,6 +3559,7 @@ namespace engine {
 #endif
 		bool sync = false;
 		engine::DecalMode decal_mode = engine::DecalMode(-1);
+		uint32_t bound_texture = uint32_t(-1);
 #if defined(ENGINE_PLATFORM_X11)
 		X11::Display* engine_Display = nullptr;
 		X11::Window* engine_Window = nullptr;
@@ -2904,12 +3577,19 @@ namespace engine {
 		locAttachShader_t* locAttachShader = nullptr;
 		locBindBuffer_t* locBindBuffer = nullptr;
 		locBufferData_t* locBufferData = nullptr;
+		locBufferSubData_t* locBufferSubData = nullptr;
 		locGenBuffers_t* locGenBuffers = nullptr;
+		locDeleteBuffers_t* locDeleteBuffers = nullptr;
 		locVertexAttribPointer_t* locVertexAttribPointer = nullptr;
 		locEnableVertexAttribArray_t* locEnableVertexAttribArray = nullptr;
 		locUseProgram_t* locUseProgram = nullptr;
 		locBindVertexArray_t* locBindVertexArray = nullptr;
 		locGenVertexArrays_t* locGenVertexArrays = nullptr;
+		locDeleteVertexArrays_t* locDeleteVertexArrays = nullptr;
+		locVertexAttribDivisor_t* locVertexAttribDivisor = nullptr;
+		locDrawArraysInstanced_t* locDrawArraysInstanced = nullptr;
+		locGetUniformLocation_t* locGetUniformLocation = nullptr;
+		locUniform2fv_t* locUniform2fv = nullptr;
 		locSwapInterval_t* locSwapInterval = nullptr;
 		locGetShaderInfoLog_t* locGetShaderInfoLog = nullptr;
 
@@ -2918,6 +3598,19 @@ namespace engine {
 		uint32_t m_nQuadShader = 0;
 		uint32_t m_vbQuad = 0;
 		uint32_t m_vaQuad = 0;
+		uint32_t m_nInstVS = 0;
+		uint32_t m_nInstShader = 0;
+		int32_t  m_uInvScreen = -1;
+		int32_t  m_uUVScale = -1;
+		uint32_t m_vbCorner = 0;
+		uint32_t m_vbInst = 0;
+		uint32_t m_vaInst = 0;
+		size_t inst_capacity = 0;
+		uint32_t m_vbDecal = 0;
+		uint32_t m_ibDecal = 0;
+		uint32_t m_vaDecal = 0;
+		size_t vb_capacity = 0;
+		size_t ib_capacity = 0;
 
 		struct locVertex {
 			float pos[3];
@@ -2925,7 +3618,27 @@ namespace engine {
 			engine::Pixel col;
 		};
 
-		locVertex pVertexMem[ENGINE_MAX_VERTS];
+		// decals gather here until the texture or mode changes, then go out as one indexed draw
+		std::vector<locVertex> batch_vertices;
+		std::vector<uint32_t> batch_indices;
+		uint32_t batch_texture = 0;
+		engine::DecalMode batch_mode = engine::DecalMode::NORMAL;
+
+		// a retained decal list as it lives on the GPU, drawn as runs sharing a decal and mode
+		struct RetainedBatch {
+			const engine::Decal* decal;
+			engine::DecalMode mode;
+			uint32_t first, count;
+		};
+
+		struct RetainedList {
+			uint32_t vb = 0, ib = 0, va = 0;
+			uint32_t revision = 0;
+			std::vector<RetainedBatch> batches;
+		};
+
+		std::unordered_map<uint32_t, RetainedList> retained;
+		uint32_t next_list_id = 1;
 
 		engine::Renderable rendBlankQuad;
 
@@ -3033,17 +3746,27 @@ namespace engine {
 			locAttachShader = OGL_LOAD(locAttachShader_t, glAttachShader);
 			locBindBuffer = OGL_LOAD(locBindBuffer_t, glBindBuffer);
 			locBufferData = OGL_LOAD(locBufferData_t, glBufferData);
+			locBufferSubData = OGL_LOAD(locBufferSubData_t, glBufferSubData);
 			locGenBuffers = OGL_LOAD(locGenBuffers_t, glGenBuffers);
+			locDeleteBuffers = OGL_LOAD(locDeleteBuffers_t, glDeleteBuffers);
 			locVertexAttribPointer = OGL_LOAD(locVertexAttribPointer_t, glVertexAttribPointer);
 			locEnableVertexAttribArray = OGL_LOAD(locEnableVertexAttribArray_t, glEnableVertexAttribArray);
 			locUseProgram = OGL_LOAD(locUseProgram_t, glUseProgram);
 			locGetShaderInfoLog = OGL_LOAD(locGetShaderInfoLog_t, glGetShaderInfoLog);
+			locGetUniformLocation = OGL_LOAD(locGetUniformLocation_t, glGetUniformLocation);
+			locUniform2fv = OGL_LOAD(locUniform2fv_t, glUniform2fv);
 #if !defined(ENGINE_PLATFORM_EMSCRIPTEN)
 			locBindVertexArray = OGL_LOAD(locBindVertexArray_t, glBindVertexArray);
 			locGenVertexArrays = OGL_LOAD(locGenVertexArrays_t, glGenVertexArrays);
+			locDeleteVertexArrays = OGL_LOAD(locDeleteVertexArrays_t, glDeleteVertexArrays);
+			locVertexAttribDivisor = OGL_LOAD(locVertexAttribDivisor_t, glVertexAttribDivisor);
+			locDrawArraysInstanced = OGL_LOAD(locDrawArraysInstanced_t, glDrawArraysInstanced);
 #else
 			locBindVertexArray = glBindVertexArrayOES;
 			locGenVertexArrays = glGenVertexArraysOES;
+			locDeleteVertexArrays = glDeleteVertexArraysOES;
+			locVertexAttribDivisor = glVertexAttribDivisorEXT;
+			locDrawArraysInstanced = glDrawArraysInstancedEXT;
 #endif
 
 			m_nFS = locCreateShader(0x8B30);
@@ -3078,6 +3801,33 @@ namespace engine {
 			locAttachShader(m_nQuadShader, m_nVS);
 			locLinkProgram(m_nQuadShader);
 
+			// sprite batches: a unit quad per vertex, everything else per instance straight from the SpriteQuad.
+			// Positions are screen pixels and texels, which mediump cannot hold exactly past 2048.
+			m_nInstVS = locCreateShader(0x8B31);
+			const GLchar* strInstVS =
+#if defined(__arm__) || defined(ENGINE_PLATFORM_EMSCRIPTEN)
+				"#version 300 es\n"
+				"precision highp float;"
+#else
+				"#version 330 core\n"
+#endif
+				"layout(location = 0) in vec2 aCorner;\n""layout(location = 1) in vec2 aPos;\n"
+				"layout(location = 2) in vec4 aSource;\n""layout(location = 3) in vec4 aCenterScale;\n"
+				"layout(location = 4) in float aAngle;\n""layout(location = 5) in vec4 aCol;\n"
+				"uniform vec2 invScreen;\n""uniform vec2 uvScale;\n""out vec2 oTex;\n""out vec4 oCol;\n"
+				"void main(){ vec2 l = (aCorner * aSource.zw - aCenterScale.xy) * aCenterScale.zw; float c = cos(aAngle); float s = sin(aAngle);"
+				" vec2 p = (aPos + vec2(l.x * c - l.y * s, l.x * s + l.y * c)) * invScreen * 2.0 - 1.0;"
+				" gl_Position = vec4(p.x, -p.y, 0.0, 1.0); oTex = (aSource.xy + aCorner * aSource.zw) * uvScale; oCol = aCol;}";
+			locShaderSource(m_nInstVS, 1, &strInstVS, NULL);
+			locCompileShader(m_nInstVS);
+
+			m_nInstShader = locCreateProgram();
+			locAttachShader(m_nInstShader, m_nFS);
+			locAttachShader(m_nInstShader, m_nInstVS);
+			locLinkProgram(m_nInstShader);
+			m_uInvScreen = locGetUniformLocation(m_nInstShader, "invScreen");
+			m_uUVScale = locGetUniformLocation(m_nInstShader, "uvScale");
+
 			locGenBuffers(1, &m_vbQuad);
 			locGenVertexArrays(1, &m_vaQuad);
 			locBindVertexArray(m_vaQuad);
@@ -3085,12 +3835,32 @@ namespace engine {
 
 			locVertex verts[ENGINE_MAX_VERTS];
 			locBufferData(0x8892, sizeof(locVertex) * ENGINE_MAX_VERTS, verts, 0x88E0);
-			locVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(locVertex), 0); locEnableVertexAttribArray(0);
-			locVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(locVertex), (void*)(3 * sizeof(float))); locEnableVertexAttribArray(1);
-			locVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(locVertex), (void*)(5 * sizeof(float)));	locEnableVertexAttribArray(2);
+			set_vertex_layout();
 			locBindBuffer(0x8892, 0);
 			locBindVertexArray(0);
 
+			// the element buffer binding is part of the vertex array, so it is bound while that is
+			locGenBuffers(1, &m_vbDecal);
+			locGenBuffers(1, &m_ibDecal);
+			locGenVertexArrays(1, &m_vaDecal);
+			locBindVertexArray(m_vaDecal);
+			locBindBuffer(0x8892, m_vbDecal);
+			locBindBuffer(0x8893, m_ibDecal);
+			set_vertex_layout();
+			locBindVertexArray(0);
+			locBindBuffer(0x8892, 0);
+
+			const float corners[8] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 1.0f };
+			locGenBuffers(1, &m_vbCorner);
+			locGenBuffers(1, &m_vbInst);
+			locGenVertexArrays(1, &m_vaInst);
+			locBindVertexArray(m_vaInst);
+			locBindBuffer(0x8892, m_vbCorner);
+			locBufferData(0x8892, sizeof(corners), corners, 0x88E4);
+			set_instance_layout();
+			locBindVertexArray(0);
+			locBindBuffer(0x8892, 0);
+
 			rendBlankQuad.create(1, 1);
 			rendBlankQuad.Sprite()->get_data()[0] = engine::WHITE;
 			rendBlankQuad.Decal()->update();
@@ -3124,6 +3894,7 @@ namespace engine {
 		}
 
 		void display_frame() override {
+			flush_decals();
 #if defined(ENGINE_PLATFORM_WINAPI)
 			SwapBuffers(glDeviceContext);
 			if (sync) DwmFlush();
@@ -3142,21 +3913,76 @@ namespace engine {
 #endif
 		}
 
-		void prepare_drawing() override {
+		// decals batch across commands, anything that is not a decal draws what is held first
+		void execute(const engine::RenderList& list) override {
+			prepare_drawing();
+			for (const engine::RenderCommand& c : list.commands) {
+				switch (c.type) {
+				case engine::RenderCommand::VIEWPORT:
+					update_viewport({ c.rect[0], c.rect[1] }, { c.rect[2], c.rect[3] });
+					break;
+				case engine::RenderCommand::SCISSOR:
+					update_scissor({ c.rect[0], c.rect[1] }, { c.rect[2], c.rect[3] });
+					break;
+				case engine::RenderCommand::CLEAR:
+					clear_buffer(c.col, c.count != 0);
+					break;
+				case engine::RenderCommand::LAYER:
+					flush_decals();
+					bind_texture(c.texture);
+					draw_layer_quad({ c.transform[0], c.transform[1] }, { c.transform[2], c.transform[3] }, c.col);
+					break;
+				case engine::RenderCommand::DECAL:
+					draw_decal(*c.decal, c.vertices);
+					break;
+				case engine::RenderCommand::DECAL_LIST:
+					draw_decal_list(*c.list);
+					break;
+				case engine::RenderCommand::SPRITE_BATCH:
+					draw_sprite_batch(*c.decal, c.quads, c.count, list.inv_screen_size);
+					break;
+				default:
+					break;
+				}
+			}
+			flush_decals();
+		}
+
+		void prepare_drawing() {
 			glEnable(GL_BLEND);
 			decal_mode = DecalMode::NORMAL;
+			bound_texture = uint32_t(-1);
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			locUseProgram(m_nQuadShader);
 			locBindVertexArray(m_vaQuad);
 
 #if defined(ENGINE_PLATFORM_EMSCRIPTEN)
+			set_vertex_layout();
+#endif
+		}
+
+		// expects the corner buffer bound, leaves the instance buffer bound
+		void set_instance_layout() {
+			locVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0); locEnableVertexAttribArray(0);
+			locBindBuffer(0x8892, m_vbInst);
+			locVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(engine::SpriteQuad), (void*)offsetof(engine::SpriteQuad, pos));
+			locVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(engine::SpriteQuad), (void*)offsetof(engine::SpriteQuad, source_pos));
+			locVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(engine::SpriteQuad), (void*)offsetof(engine::SpriteQuad, center));
+			locVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(engine::SpriteQuad), (void*)offsetof(engine::SpriteQuad, angle));
+			locVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(engine::SpriteQuad), (void*)offsetof(engine::SpriteQuad, tint));
+			for (uint32_t a = 1; a <= 5; a++) {
+				locEnableVertexAttribArray(a);
+				locVertexAttribDivisor(a, 1);
+			}
+		}
+
+		void set_vertex_layout() {
 			locVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(locVertex), 0); locEnableVertexAttribArray(0);
 			locVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(locVertex), (void*)(3 * sizeof(float))); locEnableVertexAttribArray(1);
 			locVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(locVertex), (void*)(5 * sizeof(float)));	locEnableVertexAttribArray(2);
-#endif
 		}
 
-		void set_decal_mode(const engine::DecalMode& mode) override {
+		void set_decal_mode(const engine::DecalMode& mode) {
 			if (mode != decal_mode) {
 				switch (mode) {
 				case engine::DecalMode::NORMAL: glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);	break;
@@ -3171,7 +3997,8 @@ namespace engine {
 			}
 		}
 
-		void draw_layer_quad(const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, const engine::Pixel tint) override {
+		void draw_layer_quad(const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, const engine::Pixel tint) {
+			flush_decals();
 			locBindBuffer(0x8892, m_vbQuad);
 			locVertex verts[4] = {
 				{{-1.0f, -1.0f, 1.0}, {0.0f * scale.x + offset.x, 1.0f * scale.y + offset.y}, tint},
@@ -3184,31 +4011,192 @@ namespace engine {
 			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 		}
 
-		void draw_decal(const engine::DecalInstance& decal) override
-		{
-			set_decal_mode(decal.mode);
-			if (decal.decal == nullptr)
-				glBindTexture(GL_TEXTURE_2D, rendBlankQuad.Decal()->id);
-			else
-				glBindTexture(GL_TEXTURE_2D, decal.decal->id);
-
-			locBindBuffer(0x8892, m_vbQuad);
+		void draw_decal(const engine::DecalInstance& decal, const engine::DecalVertex* vertices) {
+			uint32_t texture = (decal.decal == nullptr) ? rendBlankQuad.Decal()->id : decal.decal->id;
+			if (texture != batch_texture || decal.mode != batch_mode)
+				flush_decals();
+			batch_texture = texture;
+			batch_mode = decal.mode;
 
+			uint32_t base = uint32_t(batch_vertices.size());
 			for (uint32_t i = 0; i < decal.points; i++)
-				pVertexMem[i] = { { decal.pos[i].x, decal.pos[i].y, decal.w[i] }, { decal.uv[i].x, decal.uv[i].y }, decal.tint[i] };
+				batch_vertices.push_back({ { vertices[i].pos.x, vertices[i].pos.y, vertices[i].w }, vertices[i].uv, vertices[i].tint });
+			decal_indices(batch_indices, base, decal.points, decal.structure, decal.mode == DecalMode::WIREFRAME);
+		}
+
+		// Every structure becomes a list, so decals of any structure can share a draw: triangles,
+		// or in wireframe line pairs for each edge of them, once per edge. Strips alternate their
+		// winding like GL's.
+		static void decal_indices(std::vector<uint32_t>& out, uint32_t base, uint32_t points, engine::DecalStructure structure, bool wireframe) {
+			if (wireframe) {
+				switch (structure) {
+				case engine::DecalStructure::FAN:
+					for (uint32_t i = 1; i < points && points > 2; i++)
+						out.insert(out.end(), { base, base + i });
+					for (uint32_t i = 1; i + 1 < points; i++)
+						out.insert(out.end(), { base + i, base + i + 1 });
+					break;
+				case engine::DecalStructure::STRIP:
+					for (uint32_t i = 0; i + 1 < points && points > 2; i++)
+						out.insert(out.end(), { base + i, base + i + 1 });
+					for (uint32_t i = 0; i + 2 < points; i++)
+						out.insert(out.end(), { base + i, base + i + 2 });
+					break;
+				case engine::DecalStructure::LIST:
+					for (uint32_t i = 0; i + 2 < points; i += 3)
+						out.insert(out.end(), { base + i, base + i + 1, base + i + 1, base + i + 2, base + i + 2, base + i });
+					break;
+				default:
+					for (uint32_t i = 0; i < points && points > 1; i++)
+						out.insert(out.end(), { base + i, base + (i + 1) % points });
+					break;
+				}
+				return;
+			}
+			switch (structure) {
+			case engine::DecalStructure::FAN:
+				for (uint32_t i = 1; i + 1 < points; i++)
+					out.insert(out.end(), { base, base + i, base + i + 1 });
+				break;
+			case engine::DecalStructure::STRIP:
+				for (uint32_t i = 0; i + 2 < points; i++) {
+					if (i & 1) out.insert(out.end(), { base + i + 1, base + i, base + i + 2 });
+					else out.insert(out.end(), { base + i, base + i + 1, base + i + 2 });
+				}
+				break;
+			case engine::DecalStructure::LIST:
+				for (uint32_t i = 0; i + 2 < points; i += 3)
+					out.insert(out.end(), { base + i, base + i + 1, base + i + 2 });
+				break;
+			default:
+				break;
+			}
+		}
 
-			locBufferData(0x8892, sizeof(locVertex) * decal.points, pVertexMem, 0x88E0);
+		// the buffers only ever grow; orphaning them first lets the driver keep the last frame's copy in flight
+		void flush_decals() {
+			if (batch_indices.empty()) {
+				batch_vertices.clear();
+				return;
+			}
 
-			if (decal_mode == DecalMode::WIREFRAME)
-				glDrawArrays(GL_LINE_LOOP, 0, decal.points);
-			else {
-				if (decal.structure == engine::DecalStructure::FAN)
-					glDrawArrays(GL_TRIANGLE_FAN, 0, decal.points);
-				else if (decal.structure == engine::DecalStructure::STRIP)
-					glDrawArrays(GL_TRIANGLE_STRIP, 0, decal.points);
-				else if (decal.structure == engine::DecalStructure::LIST)
-					glDrawArrays(GL_TRIANGLES, 0, decal.points);
+			set_decal_mode(batch_mode);
+			bind_texture(batch_texture);
+			locBindVertexArray(m_vaDecal);
+			locBindBuffer(0x8892, m_vbDecal);
+#if defined(ENGINE_PLATFORM_EMSCRIPTEN)
+			locBindBuffer(0x8893, m_ibDecal);
+			set_vertex_layout();
+#endif
+			size_t vb_size = sizeof(locVertex) * batch_vertices.size(), ib_size = sizeof(uint32_t) * batch_indices.size();
+			if (vb_size > vb_capacity) vb_capacity = std::max(vb_size, vb_capacity * 2);
+			if (ib_size > ib_capacity) ib_capacity = std::max(ib_size, ib_capacity * 2);
+			locBufferData(0x8892, vb_capacity, nullptr, 0x88E0);
+			locBufferSubData(0x8892, 0, vb_size, batch_vertices.data());
+			locBufferData(0x8893, ib_capacity, nullptr, 0x88E0);
+			locBufferSubData(0x8893, 0, ib_size, batch_indices.data());
+
+			glDrawElements((batch_mode == DecalMode::WIREFRAME) ? GL_LINES : GL_TRIANGLES, GLsizei(batch_indices.size()), GL_UNSIGNED_INT, nullptr);
+
+			locBindVertexArray(m_vaQuad);
+			batch_vertices.clear();
+			batch_indices.clear();
+		}
+
+		// The list is uploaded once per revision into buffers of its own, drawn from there every frame.
+		// Textures are looked up through the decals on each draw, so reloading one needs no new upload.
+		void draw_decal_list(engine::DecalList& list) {
+			flush_decals();
+			if (list.instances.empty())
+				return;
+			if (list.id == 0)
+				list.id = next_list_id++;
+
+			RetainedList& r = retained[list.id];
+			if (r.va == 0) {
+				locGenBuffers(1, &r.vb);
+				locGenBuffers(1, &r.ib);
+				locGenVertexArrays(1, &r.va);
+				locBindVertexArray(r.va);
+				locBindBuffer(0x8892, r.vb);
+				locBindBuffer(0x8893, r.ib);
+				set_vertex_layout();
+				r.revision = list.get_revision() - 1;
+			}
+			else
+				locBindVertexArray(r.va);
+
+#if defined(ENGINE_PLATFORM_EMSCRIPTEN)
+			locBindBuffer(0x8892, r.vb);
+			locBindBuffer(0x8893, r.ib);
+			set_vertex_layout();
+#endif
+			if (r.revision != list.get_revision()) {
+				r.revision = list.get_revision();
+				r.batches.clear();
+				for (const engine::DecalInstance& decal : list.instances) {
+					const engine::DecalVertex* v = list.arena.at(decal.first);
+					uint32_t base = uint32_t(batch_vertices.size()), start = uint32_t(batch_indices.size());
+					for (uint32_t i = 0; i < decal.points; i++)
+						batch_vertices.push_back({ { v[i].pos.x, v[i].pos.y, v[i].w }, v[i].uv, v[i].tint });
+					decal_indices(batch_indices, base, decal.points, decal.structure, decal.mode == DecalMode::WIREFRAME);
+
+					uint32_t count = uint32_t(batch_indices.size()) - start;
+					if (!r.batches.empty() && r.batches.back().decal == decal.decal && r.batches.back().mode == decal.mode)
+						r.batches.back().count += count;
+					else if (count > 0)
+						r.batches.push_back({ decal.decal, decal.mode, start, count });
+				}
+				locBindBuffer(0x8892, r.vb);
+				locBufferData(0x8892, sizeof(locVertex) * batch_vertices.size(), batch_vertices.data(), 0x88E4);
+				locBufferData(0x8893, sizeof(uint32_t) * batch_indices.size(), batch_indices.data(), 0x88E4);
+				batch_vertices.clear();
+				batch_indices.clear();
+			}
+
+			for (const RetainedBatch& b : r.batches) {
+				set_decal_mode(b.mode);
+				bind_texture((b.decal == nullptr) ? rendBlankQuad.Decal()->id : b.decal->id);
+				glDrawElements((b.mode == DecalMode::WIREFRAME) ? GL_LINES : GL_TRIANGLES, GLsizei(b.count), GL_UNSIGNED_INT, (void*)(size_t(b.first) * sizeof(uint32_t)));
 			}
+			locBindVertexArray(m_vaQuad);
+		}
+
+		bool supports_instancing() override { return locDrawArraysInstanced != nullptr && locVertexAttribDivisor != nullptr; }
+
+		void draw_sprite_batch(const engine::DecalInstance& decal, const engine::SpriteQuad* quads, uint32_t count, const engine::float_vector_2d& inv_screen_size) {
+			flush_decals();
+			set_decal_mode(decal.mode);
+			bind_texture(decal.decal->id);
+			locUseProgram(m_nInstShader);
+			const float inv[2] = { inv_screen_size.x, inv_screen_size.y }, uv[2] = { decal.decal->UV_scale.x, decal.decal->UV_scale.y };
+			locUniform2fv(m_uInvScreen, 1, inv);
+			locUniform2fv(m_uUVScale, 1, uv);
+
+			locBindVertexArray(m_vaInst);
+#if defined(ENGINE_PLATFORM_EMSCRIPTEN)
+			locBindBuffer(0x8892, m_vbCorner);
+			set_instance_layout();
+#endif
+			locBindBuffer(0x8892, m_vbInst);
+			size_t size = sizeof(engine::SpriteQuad) * count;
+			if (size > inst_capacity) inst_capacity = std::max(size, inst_capacity * 2);
+			locBufferData(0x8892, inst_capacity, nullptr, 0x88E0);
+			locBufferSubData(0x8892, 0, size, quads);
+			locDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(count));
+
+			locUseProgram(m_nQuadShader);
+			locBindVertexArray(m_vaQuad);
+		}
+
+		void delete_decal_list(uint32_t id) override {
+			auto it = retained.find(id);
+			if (it == retained.end())
+				return;
+			locDeleteBuffers(1, &it->second.vb);
+			locDeleteBuffers(1, &it->second.ib);
+			locDeleteVertexArrays(1, &it->second.va);
+			retained.erase(it);
 		}
 
 		uint32_t create_texture(const uint32_t width, const uint32_t height, const bool filtered, const bool clamp) override {
@@ -3217,6 +4205,7 @@ namespace engine {
 			uint32_t id = 0;
 			glGenTextures(1, &id);
 			glBindTexture(GL_TEXTURE_2D, id);
+			bound_texture = id;
 
 			if (filtered) {
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -3242,32 +4231,68 @@ namespace engine {
 		}
 
 		uint32_t delete_texture(const uint32_t id) override {
+			flush_decals();
 			glDeleteTextures(1, &id);
+			if (id == bound_texture) bound_texture = 0;
 			return id;
 		}
 
 		void update_texture(uint32_t id, engine::Sprite* spr) override {
 			UNUSED(id);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->get_data());
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->pitch);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, spr->width, spr->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, spr->col_data.data());
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
+
+		void update_texture_region(uint32_t id, engine::Sprite* spr, int32_t x, int32_t y, int32_t w, int32_t h) override {
+			UNUSED(id);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, spr->pitch);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, spr->col_data.data() + y * spr->pitch + x);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 		}
 
 		void read_texture(uint32_t id, engine::Sprite* spr) override {
+			flush_decals();
+			glPixelStorei(GL_PACK_ROW_LENGTH, spr->pitch);
 			glReadPixels(0, 0, spr->width, spr->height, GL_RGBA, GL_UNSIGNED_BYTE, spr->get_data());
+			glPixelStorei(GL_PACK_ROW_LENGTH, 0);
 		}
 
+		// uploads follow on the texture bound here, so pending decals are drawn first with theirs
 		void apply_texture(uint32_t id) override {
-			glBindTexture(GL_TEXTURE_2D, id);
+			flush_decals();
+			bind_texture(id);
+		}
+
+		// tiles drawn from one atlas page share a texture, so most binds are redundant
+		void bind_texture(uint32_t id) {
+			if (id != bound_texture) {
+				glBindTexture(GL_TEXTURE_2D, id);
+				bound_texture = id;
+			}
 		}
 
-		void clear_buffer(engine::Pixel p, bool depth) override {
+		void clear_buffer(engine::Pixel p, bool depth) {
+			flush_decals();
 			glClearColor(float(p.r) / 255.0f, float(p.g) / 255.0f, float(p.b) / 255.0f, float(p.a) / 255.0f);
 			glClear(GL_COLOR_BUFFER_BIT);
 			if (depth) glClear(GL_DEPTH_BUFFER_BIT);
 		}
 
 		void update_viewport(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) override {
+			flush_decals();
 			glViewport(pos.x, pos.y, size.x, size.y);
 		}
+
+		void update_scissor(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) {
+			flush_decals();
+			if (size.x <= 0 || size.y <= 0) {
+				glDisable(GL_SCISSOR_TEST);
+				return;
+			}
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(pos.x, pos.y, size.x, size.y);
+		}
 	};
 }
 #endif
@@ -3348,10 +4373,7 @@ namespace engine {
 			}
 
 			if (bmp->GetLastStatus() != Gdiplus::Ok) return engine::Code::FAIL;
-			spr->width = bmp->GetWidth();
-			spr->height = bmp->GetHeight();
-
-			spr->col_data.resize(spr->width * spr->height);
+			spr->resize(bmp->GetWidth(), bmp->GetHeight());
 
 			for (int y = 0; y < spr->height; y++)
 				for (int x = 0; x < spr->width; x++)
@@ -3401,8 +4423,7 @@ namespace engine {
 				png_byte color_type;
 				png_byte bit_depth;
 				png_bytep* row_pointers;
-				spr->width = png_get_image_width(png, info);
-				spr->height = png_get_image_height(png, info);
+				spr->resize(png_get_image_width(png, info), png_get_image_height(png, info));
 				color_type = png_get_color_type(png, info);
 				bit_depth = png_get_bit_depth(png, info);
 				if (bit_depth == 16) png_set_strip_16(png);
@@ -3421,8 +4442,6 @@ namespace engine {
 				}
 				png_read_image(png, row_pointers);
 
-				spr->col_data.resize(spr->width * spr->height);
-
 				for (int y = 0; y < spr->height; y++) {
 					png_bytep row = row_pointers[y];
 					for (int x = 0; x < spr->width; x++) {
@@ -3463,9 +4482,7 @@ namespace engine {
 			return engine::Code::OK;
 
 		fail_load:
-			spr->width = 0;
-			spr->height = 0;
-			spr->col_data.clear();
+			spr->resize(0, 0);
 			return engine::Code::FAIL;
 		}
 
@@ -19,10 +19,14 @@ namespace engine {
 
 	#include "engine/utils/code.h"
 	#include "engine/headers/pixel.h"
+	#include "engine/headers/palette.h"
 
     Pixel pixel_float(float red, float green, float blue, float alpha = 1.0f);
 	Pixel pixel_lerp(const engine::Pixel& p1, const engine::Pixel& p2, float t);
 
+	#include "engine/headers/span.h"
+	#include "engine/headers/raster.h"
+
 	static const Pixel
 		GREY(192, 192, 192), DARK_GREY(128, 128, 128), RED(255, 0, 0), DARK_RED(128, 0, 0),
 		YELLOW(255, 255, 0), DARK_YELLOW(128, 128, 0), GREEN(0, 255, 0), DARK_GREEN(0, 128, 0),
@@ -41,14 +45,24 @@ namespace engine {
 
 	#include "engine/headers/img_loader.h"
 	#include "engine/headers/sprite.h"
+	#include "engine/headers/sprite_view.h"
+	#include "engine/headers/compose.h"
 	#include "engine/headers/decal.h"
+	#include "engine/headers/atlas.h"
+	#include "engine/headers/glyph_cache.h"
+	#include "engine/headers/command_buffer.h"
+	#include "engine/headers/tile_raster.h"
 
     #include "engine/utils/decal/dec_mode.h"
     #include "engine/utils/decal/dec_struct.h"
 
     #include "engine/headers/renderable.h"
 
+    #include "engine/headers/decal_arena.h"
+    #include "engine/headers/sprite_quad.h"
     #include "engine/headers/decal_instance.h"
+    #include "engine/headers/decal_list.h"
+    #include "engine/headers/render_list.h"
 
     #include "engine/headers/layer_desc.h"
 
@@ -128,14 +142,24 @@ namespace engine {
 		void set_pixel_mode(Pixel::Mode m);
 		Pixel::Mode get_pixel_mode();
 
+		// Limits drawing to the rectangle, intersected with the rectangles pushed before it. Software
+		// drawing takes it in draw target pixels, decals in screen pixels through a scissor rectangle.
+		void push_clip_rect(int32_t x, int32_t y, int32_t w, int32_t h);
+		void push_clip_rect(const engine::int_vector_2d& pos, const engine::int_vector_2d& size);
+		void pop_clip_rect();
+
 		void set_pixel_mode(std::function<engine::Pixel(const int x, const int y, const engine::Pixel& src, const engine::Pixel& dest)> pixel_mode);
 		void set_pixel_blend(float blend);
 
-		virtual bool draw(int32_t x, int32_t y, Pixel p = engine::WHITE);
+		// Every pixel a primitive writes goes through draw, unless ENGINE_FINAL_DRAW makes it final
+		virtual bool draw(int32_t x, int32_t y, Pixel p = engine::WHITE) ENGINE_DRAW_FINAL;
 		bool draw(const engine::int_vector_2d& pos, Pixel p = engine::WHITE);
 
 		void draw_line(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p = engine::WHITE, uint32_t pattern = 0xFFFFFFFF);
 		void draw_line(const engine::int_vector_2d& pos1, const engine::int_vector_2d& pos2, Pixel p = engine::WHITE, uint32_t pattern = 0xFFFFFFFF);
+		// Anti-aliased (Xiaolin Wu) line between pixel centres; it always blends, by the alpha of p times the coverage.
+		void draw_line_aa(float x1, float y1, float x2, float y2, Pixel p = engine::WHITE);
+		void draw_line_aa(const engine::float_vector_2d& pos1, const engine::float_vector_2d& pos2, Pixel p = engine::WHITE);
 
 		void draw_circle(int32_t x, int32_t y, int32_t radius, Pixel p = engine::WHITE, uint8_t mask = 0xFF);
 		void draw_circle(const engine::int_vector_2d& pos, int32_t radius, Pixel p = engine::WHITE, uint8_t mask = 0xFF);
@@ -152,13 +176,37 @@ namespace engine {
 		void fill_triangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p = engine::WHITE);
 		void fill_triangle(const engine::int_vector_2d& pos1, const engine::int_vector_2d& pos2, const engine::int_vector_2d& pos3, Pixel p = engine::WHITE);
 		
-		void fill_textured_triangle(const std::vector<engine::float_vector_2d>& points, std::vector<engine::float_vector_2d> tex, std::vector<engine::Pixel> color, engine::Sprite* spr_tex);
+		void fill_textured_triangle(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, engine::Sprite* spr_tex);
+		void fill_textured_triangle(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, engine::Sprite* spr_tex, const float* depth = nullptr);
 		void fill_textured_polygon(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, engine::Sprite* spr_tex, engine::DecalStructure structure = engine::DecalStructure::LIST);
+		void fill_textured_polygon(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, uint32_t count, engine::Sprite* spr_tex, engine::DecalStructure structure = engine::DecalStructure::LIST, const float* depth = nullptr);
+		void fill_textured_mesh(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const uint32_t* indices, uint32_t index_count, engine::Sprite* spr_tex, const float* depth = nullptr);
+		// with a view, texture coordinates span the view and its edges are where the sample mode applies
+		void fill_textured_triangle(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, const engine::SpriteView& view);
+		void fill_textured_triangle(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const engine::SpriteView& view, const float* depth = nullptr);
+		void fill_textured_polygon(const std::vector<engine::float_vector_2d>& points, const std::vector<engine::float_vector_2d>& tex, const std::vector<engine::Pixel>& color, const engine::SpriteView& view, engine::DecalStructure structure = engine::DecalStructure::LIST);
+		void fill_textured_polygon(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, uint32_t count, const engine::SpriteView& view, engine::DecalStructure structure = engine::DecalStructure::LIST, const float* depth = nullptr);
+		void fill_textured_mesh(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const uint32_t* indices, uint32_t index_count, const engine::SpriteView& view, const float* depth = nullptr);
 		
 		void draw_sprite(int32_t x, int32_t y, Sprite* sprite, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
 		void draw_sprite(const engine::int_vector_2d& pos, Sprite* sprite, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
 		void draw_partial_sprite(int32_t x, int32_t y, Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
 		void draw_partial_sprite(const engine::int_vector_2d& pos, Sprite* sprite, const engine::int_vector_2d& source_pos, const engine::int_vector_2d& size, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
+		void draw_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, Sprite* sprite, uint8_t flip = engine::Sprite::NONE);
+		void draw_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, Sprite* sprite, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, Sprite* sprite, int32_t ox, int32_t oy, int32_t sw, int32_t sh, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, Sprite* sprite, const engine::int_vector_2d& source_pos, const engine::int_vector_2d& source_size, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_sprite(int32_t x, int32_t y, engine::Atlas& atlas, int32_t region, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_sprite(const engine::int_vector_2d& pos, engine::Atlas& atlas, int32_t region, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
+		// views draw their rectangle of the sprite; partial sources are relative to the view and clipped to it
+		void draw_sprite(int32_t x, int32_t y, const engine::SpriteView& view, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
+		void draw_sprite(const engine::int_vector_2d& pos, const engine::SpriteView& view, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
+		void draw_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, const engine::SpriteView& view, uint8_t flip = engine::Sprite::NONE);
+		void draw_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, const engine::SpriteView& view, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_sprite(int32_t x, int32_t y, const engine::SpriteView& view, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_sprite(const engine::int_vector_2d& pos, const engine::SpriteView& view, const engine::int_vector_2d& source_pos, const engine::int_vector_2d& size, uint32_t scale = 1, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_scaled_sprite(int32_t x, int32_t y, int32_t w, int32_t h, const engine::SpriteView& view, int32_t ox, int32_t oy, int32_t sw, int32_t sh, uint8_t flip = engine::Sprite::NONE);
+		void draw_partial_scaled_sprite(const engine::int_vector_2d& pos, const engine::int_vector_2d& size, const engine::SpriteView& view, const engine::int_vector_2d& source_pos, const engine::int_vector_2d& source_size, uint8_t flip = engine::Sprite::NONE);
 		
 		void draw_string(int32_t x, int32_t y, const std::string& text, Pixel col = engine::WHITE, uint32_t scale = 1);
 		void draw_string(const engine::int_vector_2d& pos, const std::string& text, Pixel col = engine::WHITE, uint32_t scale = 1);
@@ -177,6 +225,12 @@ namespace engine {
 		
 		void draw_partial_decal(const engine::float_vector_2d& pos, engine::Decal* decal, const engine::float_vector_2d& source_pos, const engine::float_vector_2d& source_size, const engine::float_vector_2d& scale = { 1.0f,1.0f }, const engine::Pixel& tint = engine::WHITE);
 		void draw_partial_decal(const engine::float_vector_2d& pos, const engine::float_vector_2d& size, engine::Decal* decal, const engine::float_vector_2d& source_pos, const engine::float_vector_2d& source_size, const engine::Pixel& tint = engine::WHITE);
+		void draw_partial_decal(const engine::float_vector_2d& pos, engine::Atlas& atlas, int32_t region, const engine::float_vector_2d& scale = { 1.0f,1.0f }, const engine::Pixel& tint = engine::WHITE);
+		void draw_partial_decal(const engine::float_vector_2d& pos, const engine::float_vector_2d& size, engine::Atlas& atlas, int32_t region, const engine::Pixel& tint = engine::WHITE);
+		// Decals are textures of whole sprites, there is no decal of a view. These draw the view's
+		// rectangle of a decal made from the view's sprite.
+		void draw_partial_decal(const engine::float_vector_2d& pos, engine::Decal* decal, const engine::SpriteView& view, const engine::float_vector_2d& scale = { 1.0f,1.0f }, const engine::Pixel& tint = engine::WHITE);
+		void draw_partial_decal(const engine::float_vector_2d& pos, const engine::float_vector_2d& size, engine::Decal* decal, const engine::SpriteView& view, const engine::Pixel& tint = engine::WHITE);
 		
 		void draw_explicit_decal(engine::Decal* decal, const engine::float_vector_2d* pos, const engine::float_vector_2d* uv, const engine::Pixel* col, uint32_t elements = 4);
 		
@@ -208,6 +262,15 @@ namespace engine {
 		void draw_line_decal(const engine::float_vector_2d& pos1, const engine::float_vector_2d& pos2, Pixel p = engine::WHITE);
 		void draw_rotated_string_decal(const engine::float_vector_2d& pos, const std::string& text, const float angle, const engine::float_vector_2d& center = { 0.0f, 0.0f }, const engine::Pixel col = engine::WHITE, const engine::float_vector_2d& scale = { 1.0f, 1.0f });
 		void draw_rotated_string_prop_decal(const engine::float_vector_2d& pos, const std::string& text, const float angle, const engine::float_vector_2d& center = { 0.0f, 0.0f }, const engine::Pixel col = engine::WHITE, const engine::float_vector_2d& scale = { 1.0f, 1.0f });
+
+		// decals drawn between these replace what the list held, lists do not nest
+		void begin_decal_list(engine::DecalList& list);
+		void end_decal_list();
+		void draw_decal_list(engine::DecalList& list);
+
+		// count sprites of one decal, instanced where the renderer can and expanded into one decal where not
+		void draw_sprite_batch(engine::Decal* decal, const engine::SpriteQuad* quads, uint32_t count);
+		void draw_sprite_batch(engine::Decal* decal, const std::vector<engine::SpriteQuad>& quads);
 		
 		void clear(Pixel p);
 		void clear_buffer(Pixel p, bool depth = true);
@@ -217,6 +280,13 @@ namespace engine {
 		bool clip_line_to_screen(engine::int_vector_2d& pos1, engine::int_vector_2d& pos2);
 
 		void enable_pixel_transfer(const bool enable = true);
+		// Deferred and tiled drawing need ENGINE_FINAL_DRAW, without it primitives are drawn as they are called
+		void enable_deferred_draw(const bool enable = true);
+		void enable_tile_raster(const bool enable = true, uint32_t workers = 0, int32_t tile_size = 64);
+		// Layers hold palette indices from here on, existing ones are converted; nullptr goes back to RGBA.
+		// They are expanded through the palette on upload, so palette changes show with the next upload.
+		void enable_indexed_layers(engine::Palette* palette);
+		void flush_draw();
 
 		void console_show(const engine::Key &key_exit, bool suspend_time = true);
 		bool is_console_showing() const;
@@ -232,6 +302,34 @@ namespace engine {
 	private:
 		void update_text_entry();
 		void update_console();
+		void push_string_decal(const engine::float_vector_2d& pos, const std::string& text, const Pixel col, const engine::float_vector_2d& scale, bool prop);
+		void push_rotated_string_decal(const engine::float_vector_2d& pos, const std::string& text, const float angle, const engine::float_vector_2d& center, const Pixel col, const engine::float_vector_2d& scale, bool prop);
+
+		struct ClipRect {
+			int32_t x1, y1, x2, y2;
+		};
+
+		Raster   raster() const;
+		ClipRect clip_rect() const;
+		DecalVertex* decal_vertices(DecalInstance& di, uint32_t points);
+		void     push_decal(DecalInstance&& di);
+		void     execute_list(const RenderList& list);
+		void   submit(DrawCommand& c);
+		void   record(DrawCommand& c);
+		bool   bound(DrawCommand& c);
+		void   submit_textured(const engine::float_vector_2d* points, const engine::float_vector_2d* tex, const engine::Pixel* color, const float* depth, uint32_t i1, uint32_t i2, uint32_t i3, const engine::SpriteView& view);
+
+		template<Pixel::Mode M> void execute                 (const Raster& r, const DrawCommand& c);
+
+		template<Pixel::Mode M> void raster_line             (const Raster& r, int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern);
+		template<Pixel::Mode M> void raster_line_aa          (const Raster& r, float x1, float y1, float x2, float y2, Pixel p);
+		template<Pixel::Mode M> void raster_circle           (const Raster& r, int32_t x, int32_t y, int32_t radius, Pixel p, uint8_t mask);
+		template<Pixel::Mode M> void raster_fill_circle      (const Raster& r, int32_t x, int32_t y, int32_t radius, Pixel p);
+		template<Pixel::Mode M> void raster_fill_rect        (const Raster& r, int32_t x, int32_t y, int32_t w, int32_t h, Pixel p);
+		template<Pixel::Mode M> void raster_fill_triangle    (const Raster& r, int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p);
+		template<Pixel::Mode M> void raster_textured_triangle(const Raster& r, const engine::float_vector_2d* points, const engine::float_vector_2d* in_tex, const engine::Pixel* in_color, const float* depth, const engine::Sprite* spr_tex, const int32_t* view);
+		template<Pixel::Mode M> void raster_string           (const Raster& r, int32_t x, int32_t y, const std::string& text, Pixel col, uint32_t scale, bool prop);
+		template<Pixel::Mode M> void raster_glyph            (const Raster& r, int32_t x, int32_t y, int32_t glyph, bool prop, Pixel col, uint32_t scale);
 
 	public:
 		#include "engine/experimental/lw3d.h"
@@ -243,6 +341,7 @@ namespace engine {
 		engine::Sprite*         draw_target = nullptr;
 		Pixel::Mode	            pixel_mode = Pixel::ALPHA;
 		float		            blend_factor = 1.0f;
+		uint32_t	            blend_fixed = 256;
 		engine::int_vector_2d	screen_size = { 256, 240 };
 		engine::float_vector_2d	inv_screen_size = { 1.0f / 256.0f, 1.0f / 240.0f };
 		engine::int_vector_2d	pixel_size = { 4, 4 };
@@ -266,15 +365,27 @@ namespace engine {
 		bool                    suspend_texture_transfer = false;
 		Renderable              font_renderable;
 		std::vector<LayerDesc>  layers;
+		DecalArena              decal_arena;
+		DecalList*              recording_list = nullptr;
+		std::vector<SpriteQuad> sprite_quads;
+		RenderList              render_list;
 		uint8_t		            target_layer = 0;
 		uint32_t	            last_FPS = 0;
 		bool                    pixel_cohesion = false;
 		DecalMode               decal_mode = DecalMode::NORMAL;
 		DecalStructure          decal_structure = DecalStructure::FAN;
+		CommandBuffer           draw_commands;
+		bool                    deferred_draw = false;
+		std::unique_ptr<TileRaster> tile_raster;
+		// the target of the primitive whose pixels are going through draw
+		const Raster*           drawing = nullptr;
+		engine::Palette*        layer_palette = nullptr;
+		std::vector<ClipRect>   clip_stack;
 
 		std::function<engine::Pixel(const int x, const int y, const engine::Pixel&, const engine::Pixel&)> func_pixel_mode;
 		std::chrono::time_point<std::chrono::system_clock> time_point1, time_point2;
 		std::vector<engine::int_vector_2d> font_spacing;
+		GlyphCache              glyphs;
 
 		std::vector<std::string> dropped_files;
 		std::vector<std::string> dropped_files_cache;
@@ -0,0 +1,165 @@
+#pragma region atlas
+namespace engine {
+	// pages start at this size, or at the first power of two the region fits
+	static constexpr int32_t atlas_initial_size = 256;
+
+	Atlas::Atlas(int32_t max_size, int32_t padding, bool filter) : max_size(max_size), padding(std::max(padding, 0)), filter(filter) {}
+
+	int32_t Atlas::add(const engine::Sprite* sprite) {
+		if (sprite == nullptr)
+			return -1;
+		return add(sprite, 0, 0, sprite->width, sprite->height);
+	}
+
+	int32_t Atlas::add(const engine::Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h) {
+		if (sprite == nullptr || w <= 0 || h <= 0)
+			return -1;
+
+		// the padding surrounds every region, so filtered sampling never reads a neighbour
+		int32_t pw = w + padding * 2, ph = h + padding * 2;
+		if (pw > max_size || ph > max_size)
+			return -1;
+
+		int32_t x = 0, y = 0;
+		uint32_t page = 0;
+		for (; page < uint32_t(pages.size()); page++) {
+			if (place(pages[page], pw, ph, x, y))
+				break;
+		}
+
+		if (page == uint32_t(pages.size())) {
+			int32_t size = atlas_initial_size;
+			while (size < std::max(pw, ph)) size *= 2;
+			size = std::min(size, max_size);
+
+			Page p;
+			p.sprite = std::make_unique<engine::Sprite>(size, size);
+			std::fill(p.sprite->col_data.begin(), p.sprite->col_data.end(), engine::Pixel(0, 0, 0, 0));
+			p.skyline.push_back({ 0, 0, size });
+			pages.push_back(std::move(p));
+			place(pages.back(), pw, ph, x, y);
+		}
+
+		Page& p = pages[page];
+		Pixel* dest = p.sprite->col_data.data();
+		for (int32_t j = 0; j < h; j++)
+			for (int32_t i = 0; i < w; i++)
+				dest[(y + padding + j) * p.sprite->pitch + (x + padding + i)] = sprite->get_pixel(ox + i, oy + j);
+		p.sprite->mark_dirty(x + padding, y + padding, w, h);
+		p.dirty = true;
+
+		regions.push_back({ page, x + padding, y + padding, w, h });
+		return int32_t(regions.size()) - 1;
+	}
+
+	// Bottom left skyline: the region goes where its top edge ends up lowest, growing the page when nothing fits.
+	bool Atlas::place(Page& page, int32_t w, int32_t h, int32_t& x, int32_t& y) {
+		while (true) {
+			int32_t width = page.sprite->width, height = page.sprite->height;
+			int32_t best_y = INT32_MAX;
+			size_t best = 0;
+			for (size_t i = 0; i < page.skyline.size() && page.skyline[i].x + w <= width; i++) {
+				int32_t top = 0;
+				for (size_t j = i; j < page.skyline.size() && page.skyline[j].x < page.skyline[i].x + w; j++)
+					top = std::max(top, page.skyline[j].y);
+				if (top + h <= height && top < best_y) {
+					best_y = top;
+					best = i;
+				}
+			}
+
+			if (best_y != INT32_MAX) {
+				x = page.skyline[best].x;
+				y = best_y;
+				break;
+			}
+			if (!grow(page))
+				return false;
+		}
+
+		// the region becomes a new segment, covering what is under it
+		auto& sky = page.skyline;
+		size_t i = 0;
+		while (sky[i].x != x) i++;
+		sky.insert(sky.begin() + i, { x, y + h, w });
+		for (size_t j = i + 1; j < sky.size();) {
+			int32_t covered = x + w - sky[j].x;
+			if (covered <= 0)
+				break;
+			if (covered >= sky[j].w) {
+				sky.erase(sky.begin() + j);
+				continue;
+			}
+			sky[j].x += covered;
+			sky[j].w -= covered;
+			break;
+		}
+		for (size_t j = 1; j < sky.size();) {
+			if (sky[j].y == sky[j - 1].y) {
+				sky[j - 1].w += sky[j].w;
+				sky.erase(sky.begin() + j);
+			}
+			else j++;
+		}
+		return true;
+	}
+
+	// doubles the shorter side, keeping every pixel where it was
+	bool Atlas::grow(Page& page) {
+		if (page.drawn)
+			return false;
+
+		engine::Sprite& s = *page.sprite;
+		int32_t w = s.width, h = s.height;
+		int32_t nw = (w <= h) ? std::min(w * 2, max_size) : w;
+		int32_t nh = (w <= h) ? h : std::min(h * 2, max_size);
+		if (nw == w && nh == h) {
+			nw = std::min(w * 2, max_size);
+			nh = std::min(h * 2, max_size);
+		}
+		if (nw == w && nh == h)
+			return false;
+
+		decltype(s.col_data) old;
+		old.swap(s.col_data);
+		int32_t old_pitch = s.pitch;
+		s.resize(nw, nh);
+		std::fill(s.col_data.begin(), s.col_data.end(), engine::Pixel(0, 0, 0, 0));
+		for (int32_t y = 0; y < h; y++)
+			std::memcpy(s.col_data.data() + y * s.pitch, old.data() + y * old_pitch, w * sizeof(engine::Pixel));
+
+		if (nw > w) {
+			if (page.skyline.back().y == 0) page.skyline.back().w += nw - w;
+			else page.skyline.push_back({ w, 0, nw - w });
+		}
+		page.dirty = true;
+		return true;
+	}
+
+	void Atlas::update() {
+		for (auto& p : pages) {
+			if (!p.dirty)
+				continue;
+			if (p.decal == nullptr) p.decal = std::make_unique<engine::Decal>(p.sprite.get(), filter);
+			else p.decal->update();
+			p.dirty = false;
+		}
+	}
+
+	bool Atlas::has_region(int32_t handle) const { return handle >= 0 && handle < int32_t(regions.size()); }
+
+	// an empty region for handles that are not, so a bad handle never reads past the regions
+	const Atlas::Region& Atlas::get_region(int32_t handle) const {
+		static const Region none = { 0, 0, 0, 0, 0 };
+		return has_region(handle) ? regions[handle] : none;
+	}
+
+	engine::Sprite* Atlas::get_sprite(uint32_t page) const { return pages[page].sprite.get(); }
+
+	engine::Decal* Atlas::get_decal(uint32_t page) const {
+		pages[page].drawn = true;
+		return pages[page].decal.get();
+	}
+	uint32_t Atlas::page_count() const { return uint32_t(pages.size()); }
+}
+#pragma endregion
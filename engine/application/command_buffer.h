@@ -0,0 +1,121 @@
+#pragma region command_buffer
+namespace engine {
+	// true when the command writes every pixel of its bounds whatever was there before
+	static bool command_covers(const DrawCommand& c) {
+		if (c.type == DrawCommand::CLEAR)
+			return true;
+
+		if (c.type != DrawCommand::FILL_RECT)
+			return false;
+
+		switch (c.mode) {
+		case Pixel::NORMAL: return true;
+		case Pixel::MASK:   return c.col.a == 255;
+		case Pixel::ALPHA:  return c.col.a == 255 && c.weight == 256;
+		default:            return false;
+		}
+	}
+
+	void CommandBuffer::optimize() {
+		struct Rect { int32_t x1, y1, x2, y2; };
+		auto area = [](const Rect& r) { return int64_t(r.x2 - r.x1) * int64_t(r.y2 - r.y1); };
+
+		// walk backwards and keep the largest opaque fills seen so far as occluders
+		std::array<Rect, 8> occluders;
+		size_t occluder_count = 0;
+
+		hidden.assign(commands.size(), 0);
+		for (size_t i = commands.size(); i-- > 0;) {
+			const DrawCommand& c = commands[i];
+			for (size_t k = 0; k < occluder_count && !hidden[i]; k++) {
+				const Rect& o = occluders[k];
+				hidden[i] = o.x1 <= c.x1 && o.y1 <= c.y1 && o.x2 >= c.x2 && o.y2 >= c.y2;
+			}
+
+			if (hidden[i] || !command_covers(c))
+				continue;
+
+			Rect r = { c.x1, c.y1, c.x2, c.y2 };
+			if (occluder_count < occluders.size()) {
+				occluders[occluder_count++] = r;
+			}
+			else {
+				Rect* smallest = &occluders[0];
+				for (auto& o : occluders) if (area(o) < area(*smallest)) smallest = &o;
+				if (area(*smallest) < area(r)) *smallest = r;
+			}
+		}
+
+		size_t n = 0;
+		for (size_t i = 0; i < commands.size(); i++) {
+			if (hidden[i])
+				continue;
+
+			if (n > 0 && merge(commands[n - 1], commands[i]))
+				continue;
+
+			if (n != i) commands[n] = commands[i];
+			n++;
+		}
+		commands.resize(n);
+	}
+
+	bool CommandBuffer::merge(DrawCommand& last, const DrawCommand& c) const {
+		if (last.mode != c.mode || last.weight != c.weight)
+			return false;
+		if (last.clip_x1 != c.clip_x1 || last.clip_y1 != c.clip_y1 || last.clip_x2 != c.clip_x2 || last.clip_y2 != c.clip_y2)
+			return false;
+
+		bool fill_last = last.type == DrawCommand::FILL_RECT || last.type == DrawCommand::PLOT;
+		bool fill_next = c.type == DrawCommand::FILL_RECT || c.type == DrawCommand::PLOT;
+
+		if (fill_last && fill_next) {
+			// fills of one colour sharing a whole edge become one rectangle, single pixels included
+			if (last.col != c.col)
+				return false;
+
+			bool row = last.y1 == c.y1 && last.y2 == c.y2 && (last.x2 == c.x1 || c.x2 == last.x1);
+			bool column = last.x1 == c.x1 && last.x2 == c.x2 && (last.y2 == c.y1 || c.y2 == last.y1);
+			if (!row && !column)
+				return false;
+		}
+		else if (last.type == DrawCommand::SPRITE && c.type == DrawCommand::SPRITE) {
+			// unscaled blits of neighbouring regions of one sprite to neighbouring places
+			if (last.sprite != c.sprite || last.flip || c.flip)
+				return false;
+
+			if (last.v[6] != last.v[4] || last.v[7] != last.v[5] || c.v[6] != c.v[4] || c.v[7] != c.v[5])
+				return false;
+
+			if (last.v[1] == c.v[1] && last.v[3] == c.v[3] && last.v[5] == c.v[5] && c.v[0] == last.v[0] + last.v[4] && c.v[2] == last.v[2] + last.v[4])
+				last.v[4] = last.v[6] = last.v[4] + c.v[4];
+			else if (last.v[0] == c.v[0] && last.v[2] == c.v[2] && last.v[4] == c.v[4] && c.v[1] == last.v[1] + last.v[5] && c.v[3] == last.v[3] + last.v[5])
+				last.v[5] = last.v[7] = last.v[5] + c.v[5];
+			else
+				return false;
+		}
+		else {
+			return false;
+		}
+
+		last.x1 = std::min(last.x1, c.x1);
+		last.y1 = std::min(last.y1, c.y1);
+		last.x2 = std::max(last.x2, c.x2);
+		last.y2 = std::max(last.y2, c.y2);
+
+		if (fill_last) {
+			last.type = DrawCommand::FILL_RECT;
+			last.v[0] = last.x1;
+			last.v[1] = last.y1;
+			last.v[2] = last.x2 - last.x1;
+			last.v[3] = last.y2 - last.y1;
+		}
+		return true;
+	}
+
+	void CommandBuffer::reset() {
+		commands.clear();
+		strings.clear();
+	}
+}
+#pragma endregion
@@ -0,0 +1,93 @@
+#pragma region compose
+namespace engine {
+	// A raster over the sprite, clipped to the view. The w by h pixels at x, y of the view
+	// are what will be written, which marks them dirty.
+	static Raster compose_raster(SpriteView& view, uint32_t weight, int32_t x, int32_t y, int32_t w, int32_t h) {
+		Raster r;
+		engine::Sprite* s = view.sprite;
+		if (s == nullptr)
+			return r;
+		int32_t x1 = std::max(x, 0), y1 = std::max(y, 0);
+		s->mark_dirty(view.x + x1, view.y + y1, std::min(x + w, view.width) - x1, std::min(y + h, view.height) - y1);
+		if (s->is_indexed()) {
+			r.indices = s->index_data.data();
+			r.palette = s->palette;
+		}
+		else r.data = s->col_data.data();
+		r.width = s->width;
+		r.height = s->height;
+		r.pitch = s->pitch;
+		r.clip_x1 = view.x;
+		r.clip_y1 = view.y;
+		r.clip_x2 = view.x + view.width;
+		r.clip_y2 = view.y + view.height;
+		r.weight = weight;
+		return r;
+	}
+
+	static Pixel::Mode compose_mode(Pixel::Mode mode) { return (mode == Pixel::CUSTOM) ? Pixel::NORMAL : mode; }
+
+	void blit(SpriteView dest, int32_t x, int32_t y, const SpriteView& src, Pixel::Mode mode, float blend, uint8_t flip) {
+		if (dest.sprite == nullptr || src.sprite == nullptr)
+			return;
+		Raster r = compose_raster(dest, blend_weight(blend), x, y, src.width, src.height);
+		dispatch_mode(compose_mode(mode), [&](auto m) {
+			r.blit<decltype(m)::value>(dest.x + x, dest.y + y, src.sprite, src.x, src.y, src.width, src.height, flip);
+		});
+	}
+
+	void blit_scaled(SpriteView dest, int32_t x, int32_t y, int32_t w, int32_t h, const SpriteView& src, Pixel::Mode mode, float blend, uint8_t flip) {
+		if (dest.sprite == nullptr || src.sprite == nullptr)
+			return;
+		Raster r = compose_raster(dest, blend_weight(blend), x, y, w, h);
+		dispatch_mode(compose_mode(mode), [&](auto m) {
+			r.blit_scaled<decltype(m)::value>(dest.x + x, dest.y + y, w, h, src.sprite, src.x, src.y, src.width, src.height, flip);
+		});
+	}
+
+	void fill(SpriteView dest, Pixel p, Pixel::Mode mode, float blend) {
+		if (dest.sprite == nullptr)
+			return;
+		Raster r = compose_raster(dest, blend_weight(blend), 0, 0, dest.width, dest.height);
+		dispatch_mode(compose_mode(mode), [&](auto m) {
+			for (int32_t y = r.clip_y1; y < r.clip_y2; y++)
+				r.span<decltype(m)::value>(r.clip_x1, r.clip_x2, y, p);
+		});
+	}
+
+	void blend(SpriteView dest, int32_t x, int32_t y, const SpriteView& src, const std::function<Pixel(const int x, const int y, const Pixel&, const Pixel&)>& func) {
+		if (dest.sprite == nullptr || src.sprite == nullptr || !func)
+			return;
+		Raster r = compose_raster(dest, 256, x, y, src.width, src.height);
+		r.custom = &func;
+		r.blit<Pixel::CUSTOM>(dest.x + x, dest.y + y, src.sprite, src.x, src.y, src.width, src.height, engine::Sprite::NONE);
+	}
+
+	void copy_rect(SpriteView dest, int32_t x, int32_t y, const SpriteView& src) {
+		if (dest.sprite == nullptr || src.sprite == nullptr || dest.sprite->is_indexed() != src.sprite->is_indexed())
+			return;
+
+		// the part of src that lands inside dest
+		int32_t i0 = std::max(0, -x), j0 = std::max(0, -y);
+		int32_t i1 = std::min(src.width, dest.width - x), j1 = std::min(src.height, dest.height - y);
+		if (i0 >= i1 || j0 >= j1)
+			return;
+
+		engine::Sprite* d = dest.sprite;
+		const engine::Sprite* s = src.sprite;
+		int32_t dx = dest.x + x + i0, dy = dest.y + y + j0, sx = src.x + i0, sy = src.y + j0;
+		int32_t rows = j1 - j0;
+
+		// within one sprite, moving down copies the bottom row first so no row is overwritten before it is read
+		bool upward = (d == s && dy > sy);
+		for (int32_t k = 0; k < rows; k++) {
+			int32_t j = upward ? rows - 1 - k : k;
+			if (s->is_indexed())
+				std::memmove(d->index_data.data() + (dy + j) * d->pitch + dx, s->index_data.data() + (sy + j) * s->pitch + sx, size_t(i1 - i0));
+			else
+				std::memmove(d->col_data.data() + (dy + j) * d->pitch + dx, s->col_data.data() + (sy + j) * s->pitch + sx, size_t(i1 - i0) * sizeof(Pixel));
+		}
+		d->mark_dirty(dx, dy, i1 - i0, rows);
+	}
+}
+#pragma endregion
@@ -0,0 +1,16 @@
+#pragma region decal_arena
+namespace engine {
+	uint32_t DecalArena::allocate(uint32_t count) {
+		uint32_t offset = used;
+		used += count;
+		if (used > vertices.size())
+			vertices.resize(std::max(size_t(used), vertices.size() * 2));
+		return offset;
+	}
+
+	DecalVertex*       DecalArena::at(uint32_t offset)       { return vertices.data() + offset; }
+	const DecalVertex* DecalArena::at(uint32_t offset) const { return vertices.data() + offset; }
+	uint32_t DecalArena::size() const { return used; }
+	void     DecalArena::reset() { used = 0; }
+}
+#pragma endregion
@@ -0,0 +1,18 @@
+#pragma region decal_list
+namespace engine {
+	DecalList::~DecalList() {
+		if (id != 0 && renderer != nullptr)
+			renderer->delete_decal_list(id);
+	}
+
+	void DecalList::invalidate() {
+		instances.clear();
+		arena.reset();
+		revision++;
+		valid = false;
+	}
+
+	bool DecalList::is_valid() const { return valid; }
+	uint32_t DecalList::get_revision() const { return revision; }
+}
+#pragma endregion
@@ -0,0 +1,145 @@
+#pragma region glyph_cache
+namespace engine {
+	void GlyphCache::update(const engine::Sprite* font, const std::vector<engine::int_vector_2d>& spacing) {
+		if (font == nullptr || (built && font_revision == font->revision))
+			return;
+		built = true;
+		font_revision = font->revision;
+
+		for (int32_t g = 0; g < 96; g++) {
+			int32_t ox = (g % 16) * 8, oy = (g / 16) * 8;
+			uint64_t mono = 0, prop = 0;
+			int32_t start = (g < int32_t(spacing.size())) ? spacing[g].x : 0;
+			int32_t width = (g < int32_t(spacing.size())) ? spacing[g].y : 8;
+			for (int32_t y = 0; y < 8; y++) {
+				uint64_t row = 0;
+				for (int32_t x = 0; x < 8; x++)
+					if (font->get_pixel(ox + x, oy + y).r > 0) row |= uint64_t(1) << x;
+				mono |= row << (y * 8);
+				prop |= ((row >> start) & ((1u << width) - 1)) << (y * 8);
+			}
+			masks[g] = mono;
+			masks[96 + g] = prop;
+			widths[g] = uint8_t(width);
+			starts[g] = uint8_t(start);
+		}
+
+		// the runs and sizes came from the old glyphs
+		for (Scale& s : scales) s.runs.clear();
+		sizes[0].clear();
+		sizes[1].clear();
+		meshes.clear();
+	}
+
+	void GlyphCache::prepare(uint32_t scale) {
+		if (scale == 0 || scale > max_scale || !scales[scale].runs.empty())
+			return;
+
+		Scale& s = scales[scale];
+		int16_t k = int16_t(scale);
+		for (int32_t g = 0; g < 192; g++) {
+			s.first[g] = uint32_t(s.runs.size());
+			for (int16_t y = 0; y < 8; y++) {
+				uint32_t row = uint32_t(masks[g] >> (y * 8)) & 0xFF;
+				for (int16_t x = 0; x < 8;) {
+					if (!(row & (1u << x))) { x++; continue; }
+					int16_t end = x;
+					while (end < 8 && (row & (1u << end))) end++;
+					for (int16_t j = 0; j < k; j++)
+						s.runs.push_back({ int16_t(x * k), int16_t(end * k), int16_t(y * k + j) });
+					x = end;
+				}
+			}
+		}
+		s.first[192] = uint32_t(s.runs.size());
+	}
+
+	int32_t GlyphCache::glyph_of(char c) {
+		int32_t g = int32_t(uint8_t(c)) - 32;
+		return (g >= 0 && g < 96) ? g : -1;
+	}
+
+	uint64_t GlyphCache::get_mask(int32_t glyph, bool prop) const { return (glyph < 0) ? 0 : masks[(prop ? 96 : 0) + glyph]; }
+
+	int32_t GlyphCache::get_width(int32_t glyph, bool prop) const { return (prop && glyph >= 0) ? widths[glyph] : 8; }
+
+	const GlyphCache::Run* GlyphCache::get_runs(int32_t glyph, bool prop, uint32_t scale, int32_t& count) const {
+		if (glyph < 0 || scale == 0 || scale > max_scale || scales[scale].runs.empty())
+			return nullptr;
+		const Scale& s = scales[scale];
+		int32_t g = (prop ? 96 : 0) + glyph;
+		count = int32_t(s.first[g + 1] - s.first[g]);
+		return s.runs.data() + s.first[g];
+	}
+
+	engine::int_vector_2d GlyphCache::text_size(const std::string& s, bool prop) {
+		auto& cache = sizes[prop ? 1 : 0];
+		auto found = cache.find(s);
+		if (found != cache.end())
+			return found->second;
+
+		engine::int_vector_2d size = { 0, 1 };
+		engine::int_vector_2d pos = { 0, 1 };
+		for (auto c : s) {
+			if (c == '\n') {
+				pos.y++;
+				pos.x = 0;
+			}
+			else if (c == '\t') pos.x += prop ? tab_size_in_spaces * 8 : tab_size_in_spaces;
+			else pos.x += prop ? get_width(glyph_of(c), true) : 1;
+			size.x = std::max(size.x, pos.x);
+			size.y = std::max(size.y, pos.y);
+		}
+		size = prop ? engine::int_vector_2d(size.x, size.y * 8) : size * 8;
+
+		if (cache.size() >= max_sizes)
+			cache.clear();
+		cache.emplace(s, size);
+		return size;
+	}
+
+	const GlyphCache::TextMesh& GlyphCache::text_mesh(const std::string& s, bool prop, const engine::float_vector_2d& scale, engine::Pixel col, const engine::float_vector_2d& uv_scale) {
+		MeshKey key = { s, scale.x, scale.y, col.n, prop };
+		auto found = meshes.find(key);
+		if (found != meshes.end())
+			return found->second;
+
+		if (meshes.size() >= max_meshes)
+			meshes.clear();
+		TextMesh& mesh = meshes[std::move(key)];
+
+		engine::float_vector_2d spos = { 0.0f, 0.0f };
+		for (auto c : s) {
+			if (c == '\n') {
+				spos.x = 0.0f;
+				spos.y += 8.0f * scale.y;
+				continue;
+			}
+			if (c == '\t') {
+				spos.x += 8.0f * float(tab_size_in_spaces) * scale.x;
+				continue;
+			}
+			// characters without a glyph still take up their width, as in draw_string and text_size
+			int32_t g = glyph_of(c);
+			float width = float(get_width(g, prop));
+			if (g < 0) {
+				spos.x += width * scale.x;
+				continue;
+			}
+
+			engine::float_vector_2d source = { float((g % 16) * 8 + (prop ? starts[g] : 0)), float((g / 16) * 8) };
+			engine::float_vector_2d uvtl = (source + engine::float_vector_2d(0.0001f, 0.0001f)) * uv_scale;
+			engine::float_vector_2d uvbr = (source + engine::float_vector_2d(width, 8.0f) - engine::float_vector_2d(0.0001f, 0.0001f)) * uv_scale;
+
+			mesh.quads.push_back(spos);
+			mesh.quads.push_back(spos + engine::float_vector_2d(width, 8.0f) * scale);
+			// two triangles, as the four point fan of a single decal would be split
+			mesh.uv.insert(mesh.uv.end(), { { uvtl.x, uvtl.y }, { uvtl.x, uvbr.y }, { uvbr.x, uvbr.y }, { uvtl.x, uvtl.y }, { uvbr.x, uvbr.y }, { uvbr.x, uvtl.y } });
+			spos.x += width * scale.x;
+		}
+		mesh.tint.assign(mesh.uv.size(), col);
+		mesh.w.assign(mesh.uv.size(), 1.0f);
+		return mesh;
+	}
+}
+#pragma endregion
@@ -0,0 +1,82 @@
+#pragma region palette
+namespace engine {
+	static inline uint32_t palette_hash(uint32_t n) { return (n * 2654435761u) >> 23; }
+
+	Palette::Palette(uint32_t size) : size(std::min(std::max(size, 1u), 256u)) {
+		colours.fill(Pixel(0, 0, 0));
+		update();
+	}
+
+	Palette::Palette(const std::vector<engine::Pixel>& c) : size(std::min(std::max(uint32_t(c.size()), 1u), 256u)) {
+		colours.fill(Pixel(0, 0, 0));
+		std::copy_n(c.begin(), std::min(size_t(size), c.size()), colours.begin());
+		update();
+	}
+
+	void Palette::set(uint8_t index, Pixel p) {
+		colours[index] = p;
+		revision++;
+	}
+
+	Pixel Palette::get(uint8_t index) const { return colours[index]; }
+
+	void Palette::cycle(uint8_t first, uint8_t last, int32_t step) {
+		if (first >= last)
+			return;
+		int32_t count = last - first + 1;
+		int32_t shift = ((step % count) + count) % count;
+		std::rotate(colours.begin() + first, colours.begin() + first + (count - shift) % count, colours.begin() + last + 1);
+
+		// within the palette the colours stay the same, so current tables only need their indices moved
+		bool current = table_revision == revision && last < size;
+		revision++;
+		if (!current)
+			return;
+		auto moved = [&](uint32_t i) { return (i >= first && i <= last) ? first + (i - first + shift) % count : i; };
+		for (uint16_t& e : exact)
+			if (e != 0) e = uint16_t(moved(e - 1) + 1);
+		for (uint8_t& n : nearest)
+			n = uint8_t(moved(n));
+		table_revision = revision;
+	}
+
+	uint8_t Palette::find(Pixel p) const {
+		for (uint32_t h = palette_hash(p.n); exact[h] != 0; h = (h + 1) & 511) {
+			if (colours[exact[h] - 1] == p)
+				return uint8_t(exact[h] - 1);
+		}
+		return nearest[((p.r >> 4) << 8) | ((p.g >> 4) << 4) | (p.b >> 4)];
+	}
+
+	void Palette::update() {
+		if (table_revision == revision)
+			return;
+		table_revision = revision;
+
+		// the first of equal entries wins
+		exact.fill(0);
+		for (uint32_t i = 0; i < size; i++) {
+			uint32_t h = palette_hash(colours[i].n);
+			while (exact[h] != 0 && colours[exact[h] - 1] != colours[i]) h = (h + 1) & 511;
+			if (exact[h] == 0) exact[h] = uint16_t(i + 1);
+		}
+
+		// fully transparent entries are only ever matched exactly
+		for (uint32_t c = 0; c < 4096; c++) {
+			int32_t r = int32_t((c >> 8) & 15) * 17, g = int32_t((c >> 4) & 15) * 17, b = int32_t(c & 15) * 17;
+			int32_t best = INT32_MAX;
+			nearest[c] = 0;
+			for (uint32_t i = 0; i < size; i++) {
+				const Pixel& e = colours[i];
+				if (e.a == 0)
+					continue;
+				int32_t d = (e.r - r) * (e.r - r) + (e.g - g) * (e.g - g) + (e.b - b) * (e.b - b);
+				if (d < best) {
+					best = d;
+					nearest[c] = uint8_t(i);
+				}
+			}
+		}
+	}
+}
+#pragma endregion
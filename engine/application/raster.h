@@ -0,0 +1,427 @@
+#pragma region raster
+namespace engine {
+	// rounds towards negative infinity, b is positive
+	static inline int64_t floor_div(int64_t a, int64_t b) { return (a >= 0) ? a / b : -((b - 1 - a) / b); }
+
+	bool Raster::shade(Pixel& d, int32_t x, int32_t y, Pixel p) const {
+		if (owner != nullptr)
+			return owner->draw(x, y, p);
+		d = (*custom)(x, y, p, d);
+		return true;
+	}
+
+	bool Raster::shade(uint8_t& i, int32_t x, int32_t y, Pixel p) const {
+		if (owner != nullptr)
+			return owner->draw(x, y, p);
+		i = palette->find((*custom)(x, y, p, palette->colours[i]));
+		return true;
+	}
+
+	template<Pixel::Mode M>
+	bool Raster::plot(int32_t x, int32_t y, Pixel p) const {
+		if (x < clip_x1 || y < clip_y1 || x >= clip_x2 || y >= clip_y2)
+			return false;
+		return put<M>(x, y, p);
+	}
+
+	template<Pixel::Mode M>
+	bool Raster::put(int32_t x, int32_t y, Pixel p) const { return write<M>(y * pitch + x, x, y, p); }
+
+	template<Pixel::Mode M>
+	bool Raster::write(int32_t offset, int32_t x, int32_t y, Pixel p) const {
+		if (indices != nullptr) {
+			uint8_t& i = indices[offset];
+			switch (M) {
+			case Pixel::NORMAL: i = palette->find(p); break;
+			case Pixel::MASK:   if (p.a != 255) return false; i = palette->find(p); break;
+			case Pixel::ALPHA:  i = palette->find(blend_pixel(p, palette->colours[i], weight)); break;
+			case Pixel::CUSTOM: return shade(i, x, y, p);
+			}
+			return true;
+		}
+
+		Pixel& d = data[offset];
+		switch (M) {
+		case Pixel::NORMAL: d = p; break;
+		case Pixel::MASK:   if (p.a != 255) return false; d = p; break;
+		case Pixel::ALPHA:  d = blend_pixel(p, d, weight); break;
+		case Pixel::CUSTOM: return shade(d, x, y, p);
+		}
+		return true;
+	}
+
+	template<Pixel::Mode M>
+	void Raster::cover(int32_t x, int32_t y, Pixel p, uint32_t coverage) const {
+		if (x < clip_x1 || y < clip_y1 || x >= clip_x2 || y >= clip_y2 || coverage == 0)
+			return;
+
+		if (M == Pixel::CUSTOM) {
+			p.a = uint8_t((p.a * coverage) >> 8);
+			put<M>(x, y, p);
+			return;
+		}
+
+		uint32_t w = (weight * coverage) >> 8;
+		if (indices != nullptr) {
+			uint8_t& i = indices[y * pitch + x];
+			i = palette->find(blend_pixel(p, palette->colours[i], w));
+		}
+		else {
+			Pixel& d = data[y * pitch + x];
+			d = blend_pixel(p, d, w);
+		}
+	}
+
+	template<Pixel::Mode M>
+	void Raster::span(int32_t x1, int32_t x2, int32_t y, Pixel p) const {
+		if (y < clip_y1 || y >= clip_y2)
+			return;
+
+		x1 = std::max(x1, clip_x1);
+		x2 = std::min(x2, clip_x2);
+		if (x1 >= x2)
+			return;
+
+		int32_t count = x2 - x1;
+		if (indices != nullptr) {
+			uint8_t* dest = indices + y * pitch + x1;
+			bool solid = (M == Pixel::NORMAL) || (M == Pixel::MASK && p.a == 255) || (M == Pixel::ALPHA && p.a == 255 && weight == 256);
+			if (solid)
+				std::memset(dest, palette->find(p), count);
+			else if (M != Pixel::MASK)
+				for (int32_t i = 0; i < count; i++)
+					plot<M>(x1 + i, y, p);
+			return;
+		}
+
+		Pixel* dest = data + y * pitch + x1;
+
+		switch (M) {
+		case Pixel::NORMAL:
+			span_fill(dest, p, count);
+			break;
+		case Pixel::MASK:
+			if (p.a == 255) span_fill(dest, p, count);
+			break;
+		case Pixel::ALPHA:
+			if (p.a == 255 && weight == 256) span_fill(dest, p, count);
+			else span_blend_solid(dest, p, count, weight);
+			break;
+		case Pixel::CUSTOM:
+			for (int32_t i = 0; i < count; i++)
+				shade(dest[i], x1 + i, y, p);
+			break;
+		}
+	}
+
+	template<Pixel::Mode M>
+	void Raster::row(int32_t x, int32_t y, const Pixel* src, int32_t step, int32_t count) const {
+		if (indices != nullptr) {
+			uint8_t* dest = indices + y * pitch + x;
+			for (int32_t i = 0; i < count; i++, src += step) {
+				if (M == Pixel::NORMAL)
+					dest[i] = palette->find(*src);
+				else
+					plot<M>(x + i, y, *src);
+			}
+			return;
+		}
+
+		Pixel* dest = data + y * pitch + x;
+		switch (M) {
+		case Pixel::NORMAL:
+			span_copy(dest, src, step, count);
+			break;
+		case Pixel::MASK:
+			span_mask(dest, src, step, count);
+			break;
+		case Pixel::ALPHA:
+			span_blend(dest, src, step, count, weight);
+			break;
+		case Pixel::CUSTOM:
+			for (int32_t i = 0; i < count; i++, src += step)
+				shade(dest[i], x + i, y, *src);
+			break;
+		}
+	}
+
+	template<Pixel::Mode M>
+	void Raster::row_indexed(int32_t x, int32_t y, const uint8_t* src, int32_t step, int32_t count) const {
+		uint8_t* dest = indices + y * pitch + x;
+		if (M == Pixel::NORMAL && step == 1) {
+			std::memcpy(dest, src, count);
+			return;
+		}
+
+		const Pixel* colours = palette->colours.data();
+		for (int32_t i = 0; i < count; i++, src += step) {
+			const Pixel& p = colours[*src];
+			switch (M) {
+			case Pixel::NORMAL: dest[i] = *src; break;
+			case Pixel::MASK:   if (p.a == 255) dest[i] = *src; break;
+			case Pixel::ALPHA:  dest[i] = (p.a == 255 && weight == 256) ? *src : palette->find(blend_pixel(p, colours[dest[i]], weight)); break;
+			case Pixel::CUSTOM: shade(dest[i], x + i, y, p); break;
+			}
+		}
+	}
+
+	template<Pixel::Mode M>
+	void Raster::blit(int32_t x, int32_t y, const engine::Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint8_t flip) const {
+		if (w <= 0 || h <= 0)
+			return;
+
+		// clip the destination rectangle once
+		int32_t i0 = std::max(0, clip_x1 - x);
+		int32_t j0 = std::max(0, clip_y1 - y);
+		int32_t i1 = std::min(w, clip_x2 - x);
+		int32_t j1 = std::min(h, clip_y2 - y);
+		if (i0 >= i1 || j0 >= j1)
+			return;
+
+		// flips walk the source backwards, so they reduce to a start texel and a stride
+		int32_t sxm = (flip & engine::Sprite::Flip::HORIZ) ? -1 : 1;
+		int32_t sym = (flip & engine::Sprite::Flip::VERT) ? -1 : 1;
+		int32_t sx = (sxm < 0) ? ox + w - 1 - i0 : ox + i0;
+		int32_t sy = (sym < 0) ? oy + h - 1 - j0 : oy + j0;
+		int32_t cols = i1 - i0;
+		int32_t rows = j1 - j0;
+
+		int32_t sx_end = sx + sxm * (cols - 1);
+		int32_t sy_end = sy + sym * (rows - 1);
+
+		if (std::min(sx, sx_end) < 0 || std::max(sx, sx_end) >= sprite->width || std::min(sy, sy_end) < 0 || std::max(sy, sy_end) >= sprite->height) {
+			// source rectangle leaves the sprite, so let get_pixel apply the sample mode
+			for (int32_t j = j0; j < j1; j++) {
+				int32_t fy = (sym < 0) ? oy + h - 1 - j : oy + j;
+				for (int32_t i = i0; i < i1; i++) {
+					int32_t fx = (sxm < 0) ? ox + w - 1 - i : ox + i;
+					plot<M>(x + i, y + j, sprite->get_pixel(fx, fy));
+				}
+			}
+			return;
+		}
+
+		ptrdiff_t src_pitch = ptrdiff_t(sym) * sprite->pitch;
+
+		// indexed sprites keep their indices on a target with the same palette, anything else gets colours
+		if (sprite->is_indexed()) {
+			const uint8_t* src = sprite->get_indices() + sy * sprite->pitch + sx;
+			if (palette == sprite->palette) {
+				for (int32_t j = 0; j < rows; j++, src += src_pitch)
+					row_indexed<M>(x + i0, y + j0 + j, src, sxm, cols);
+				return;
+			}
+
+			thread_local std::vector<Pixel> line;
+			line.resize(cols);
+			const Pixel* colours = sprite->palette->colours.data();
+			for (int32_t j = 0; j < rows; j++, src += src_pitch) {
+				for (int32_t i = 0; i < cols; i++) line[i] = colours[src[i * sxm]];
+				row<M>(x + i0, y + j0 + j, line.data(), 1, cols);
+			}
+			return;
+		}
+
+		const Pixel* src = sprite->get_data() + sy * sprite->pitch + sx;
+
+		// Compiled sprites only touch the texels that can change the destination: opaque runs
+		// are copied, partly transparent runs are blended (or dropped by MASK) and the gaps
+		// between runs are skipped, so ALPHA leaves the alpha under transparent texels as it was.
+		if ((M == Pixel::MASK || M == Pixel::ALPHA) && sprite->is_compiled() && indices == nullptr) {
+			Pixel* dest = data + (y + j0) * pitch + (x + i0);
+			int32_t c0 = std::min(sx, sx_end), c1 = std::max(sx, sx_end) + 1;
+			for (int32_t j = 0; j < rows; j++, src += src_pitch, dest += pitch) {
+				int32_t count;
+				const engine::Sprite::Run* run = sprite->get_runs(sy + j * sym, count);
+				for (int32_t k = 0; k < count && run[k].x < c1; k++) {
+					int32_t a = std::max(run[k].x, c0), b = std::min(run[k].x + run[k].count, c1);
+					if (a >= b || (M == Pixel::MASK && !run[k].opaque))
+						continue;
+
+					// src is the texel under dest, a flipped row reads its runs from the far end
+					Pixel* d = (sxm > 0) ? dest + (a - sx) : dest + (sx - (b - 1));
+					const Pixel* s = (sxm > 0) ? src + (a - sx) : src + (b - 1 - sx);
+					if (run[k].opaque && (M == Pixel::MASK || weight == 256))
+						span_copy(d, s, sxm, b - a);
+					else
+						span_blend(d, s, sxm, b - a, weight);
+				}
+			}
+			return;
+		}
+
+		for (int32_t j = 0; j < rows; j++, src += src_pitch)
+			row<M>(x + i0, y + j0 + j, src, sxm, cols);
+	}
+
+	template<Pixel::Mode M>
+	void Raster::blit_scaled(int32_t x, int32_t y, int32_t dw, int32_t dh, const engine::Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint8_t flip) const {
+		if (w <= 0 || h <= 0 || dw <= 0 || dh <= 0)
+			return;
+
+		int32_t i0 = std::max(0, clip_x1 - x);
+		int32_t j0 = std::max(0, clip_y1 - y);
+		int32_t i1 = std::min(dw, clip_x2 - x);
+		int32_t j1 = std::min(dh, clip_y2 - y);
+		if (i0 >= i1 || j0 >= j1)
+			return;
+
+		// nearest source column of every destination column, with the flip folded in
+		thread_local std::vector<int32_t> columns;
+		thread_local std::vector<Pixel> expanded;
+		int32_t cols = i1 - i0;
+		columns.resize(cols);
+		expanded.resize(cols);
+
+		bool inside = true;
+		for (int32_t i = 0; i < cols; i++) {
+			int32_t fx = int32_t(int64_t(i0 + i) * w / dw);
+			if (flip & engine::Sprite::Flip::HORIZ) fx = w - 1 - fx;
+			columns[i] = ox + fx;
+			inside = inside && columns[i] >= 0 && columns[i] < sprite->width;
+		}
+
+		// each source row is expanded once, then copied or blended into every destination row it covers
+		bool keep_indices = inside && sprite->is_indexed() && palette == sprite->palette;
+		bool direct = (M == Pixel::NORMAL) && indices == nullptr;
+		thread_local std::vector<uint8_t> expanded_indices;
+		if (keep_indices) expanded_indices.resize(cols);
+
+		Pixel* dest = direct ? data + (y + j0) * pitch + (x + i0) : nullptr;
+		const Pixel* line = nullptr;
+		int32_t line_y = INT32_MIN;
+
+		for (int32_t j = j0; j < j1; j++, dest += direct ? pitch : 0) {
+			int32_t fy = int32_t(int64_t(j) * h / dh);
+			if (flip & engine::Sprite::Flip::VERT) fy = h - 1 - fy;
+			int32_t sy = oy + fy;
+
+			if (keep_indices && sy >= 0 && sy < sprite->height) {
+				if (sy != line_y) {
+					const uint8_t* src = sprite->get_indices() + sy * sprite->pitch;
+					for (int32_t i = 0; i < cols; i++) expanded_indices[i] = src[columns[i]];
+					line_y = sy;
+				}
+				row_indexed<M>(x + i0, y + j, expanded_indices.data(), 1, cols);
+				continue;
+			}
+
+			if (sy != line_y) {
+				Pixel* out = direct ? dest : expanded.data();
+				if (inside && sy >= 0 && sy < sprite->height && sprite->is_indexed()) {
+					const uint8_t* src = sprite->get_indices() + sy * sprite->pitch;
+					const Pixel* colours = sprite->palette->colours.data();
+					for (int32_t i = 0; i < cols; i++) out[i] = colours[src[columns[i]]];
+				}
+				else if (inside && sy >= 0 && sy < sprite->height) {
+					const Pixel* src = sprite->get_data() + sy * sprite->pitch;
+					for (int32_t i = 0; i < cols; i++) out[i] = src[columns[i]];
+				}
+				else {
+					for (int32_t i = 0; i < cols; i++) out[i] = sprite->get_pixel(columns[i], sy);
+				}
+
+				line = out;
+				line_y = sy;
+				if (direct)
+					continue;
+			}
+
+			row<M>(x + i0, y + j, line, 1, cols);
+		}
+	}
+
+	// Half-space rasterizer: a pixel is covered when its centre lies inside all
+	// three edge functions. Edges that are neither top nor left exclude the
+	// centres on them, so triangles sharing an edge never cover a pixel twice.
+	// Each row is one span, bounded by the edges facing left and right.
+	template<typename F>
+	void Raster::triangle(const int32_t* x, const int32_t* y, F&& span) const {
+		constexpr int32_t one = 1 << subpixel_bits;
+
+		int32_t vx[3] = { x[0], x[1], x[2] };
+		int32_t vy[3] = { y[0], y[1], y[2] };
+		int64_t area = (int64_t(vx[1]) - vx[0]) * (int64_t(vy[2]) - vy[0]) - (int64_t(vy[1]) - vy[0]) * (int64_t(vx[2]) - vx[0]);
+		if (area == 0)
+			return;
+
+		if (area < 0) {
+			std::swap(vx[1], vx[2]);
+			std::swap(vy[1], vy[2]);
+		}
+
+		int32_t bx1 = std::max(clip_x1, std::min({ vx[0], vx[1], vx[2] }) >> subpixel_bits);
+		int32_t by1 = std::max(clip_y1, std::min({ vy[0], vy[1], vy[2] }) >> subpixel_bits);
+		int32_t bx2 = std::min(clip_x2, (std::max({ vx[0], vx[1], vx[2] }) >> subpixel_bits) + 1);
+		int32_t by2 = std::min(clip_y2, (std::max({ vy[0], vy[1], vy[2] }) >> subpixel_bits) + 1);
+		if (bx1 >= bx2 || by1 >= by2)
+			return;
+
+		// Edge i runs from vertex i to vertex i + 1 and changes by a per column, b per row. at is
+		// where it crosses the current row, relative to bx1: the first column inside when a > 0,
+		// the first column outside when a < 0, and e is the edge value there. Like a line, at
+		// moves q columns and e moves r per row, plus a carry that keeps e within one column.
+		// Horizontal edges take or reject whole rows instead.
+		int64_t a[3], at[3], e[3], q[3], r[3], right[3], flat[3];
+		for (int i = 0; i < 3; i++) {
+			int j = (i + 1) % 3;
+			int64_t dx = int64_t(vx[j]) - vx[i];
+			int64_t dy = int64_t(vy[j]) - vy[i];
+			bool top_left = dy < 0 || (dy == 0 && dx > 0);
+
+			int64_t px = int64_t(bx1) * one + one / 2 - vx[i];
+			int64_t py = int64_t(by1) * one + one / 2 - vy[i];
+			int64_t ev = dx * py - dy * px - (top_left ? 0 : 1);
+			int64_t b = dx * one;
+			a[i] = -dy * one;
+			right[i] = (a[i] < 0) ? -1 : 0;
+			flat[i] = (a[i] == 0) ? -1 : 0;
+
+			if (a[i] == 0) {
+				at[i] = INT64_MIN / 2; e[i] = ev; q[i] = 0; r[i] = b;
+				continue;
+			}
+
+			// floating point gives the answers up to rounding, the integer loops make them exact
+			double inv = -1.0 / double(a[i]);
+			double fa = double(ev) * inv, fq = double(b) * inv;
+			int64_t ta = int64_t(fa), tq = int64_t(fq);
+			at[i] = (a[i] > 0) ? ta + (fa > double(ta)) : ta - (fa < double(ta)) + 1;
+			q[i] = tq - (fq < double(tq));
+			e[i] = ev + a[i] * at[i];
+			r[i] = b + a[i] * q[i];
+			if (a[i] > 0) {
+				while (e[i] < 0)       { at[i]++; e[i] += a[i]; }
+				while (e[i] >= a[i])   { at[i]--; e[i] -= a[i]; }
+				while (r[i] > 0)       { q[i]--;  r[i] -= a[i]; }
+				while (r[i] <= -a[i])  { q[i]++;  r[i] += a[i]; }
+			}
+			else {
+				while (e[i] >= 0)      { at[i]++; e[i] += a[i]; }
+				while (e[i] < a[i])    { at[i]--; e[i] -= a[i]; }
+				while (r[i] < 0)       { q[i]--;  r[i] -= a[i]; }
+				while (r[i] >= -a[i])  { q[i]++;  r[i] += a[i]; }
+			}
+		}
+
+		// selects and masks rather than branches, which would mispredict on short triangles
+		int64_t width = bx2 - bx1;
+		for (int32_t py = by1; py < by2; py++) {
+			int64_t lo = 0, hi = width;
+			for (int i = 0; i < 3; i++) {
+				lo = std::max(lo, right[i] ? lo : at[i]);
+				hi = std::min(hi, right[i] ? at[i] : hi);
+				hi &= ~((e[i] >> 63) & flat[i]);
+
+				e[i] += r[i];
+				int64_t carry = (e[i] >> 63) ^ right[i];
+				at[i] += q[i] - carry;
+				e[i] += a[i] & carry;
+			}
+
+			if (lo < hi)
+				span(bx1 + int32_t(lo), bx1 + int32_t(hi), py);
+		}
+	}
+}
+#pragma endregion
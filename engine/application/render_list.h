@@ -0,0 +1,82 @@
+#pragma region render_list
+namespace engine {
+	RenderCommand& RenderList::push(RenderCommand::Type type) {
+		commands.emplace_back();
+		commands.back().type = type;
+		return commands.back();
+	}
+
+	void RenderList::viewport(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) {
+		RenderCommand& c = push(RenderCommand::VIEWPORT);
+		c.rect[0] = pos.x; c.rect[1] = pos.y; c.rect[2] = size.x; c.rect[3] = size.y;
+	}
+
+	void RenderList::scissor(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) {
+		RenderCommand& c = push(RenderCommand::SCISSOR);
+		c.rect[0] = pos.x; c.rect[1] = pos.y; c.rect[2] = size.x; c.rect[3] = size.y;
+	}
+
+	void RenderList::clear_buffer(engine::Pixel p, bool depth) {
+		RenderCommand& c = push(RenderCommand::CLEAR);
+		c.col = p;
+		c.count = depth ? 1 : 0;
+	}
+
+	void RenderList::layer(uint32_t texture, const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, engine::Pixel tint) {
+		RenderCommand& c = push(RenderCommand::LAYER);
+		c.texture = texture;
+		c.transform[0] = offset.x; c.transform[1] = offset.y; c.transform[2] = scale.x; c.transform[3] = scale.y;
+		c.col = tint;
+	}
+
+	void RenderList::decal(const DecalInstance& decal, const DecalVertex* vertices) {
+		RenderCommand& c = push(RenderCommand::DECAL);
+		c.decal = &decal;
+		c.vertices = vertices;
+	}
+
+	void RenderList::decal_list(DecalList& list) {
+		push(RenderCommand::DECAL_LIST).list = &list;
+	}
+
+	void RenderList::sprite_batch(const DecalInstance& decal, const SpriteQuad* quads, uint32_t count) {
+		RenderCommand& c = push(RenderCommand::SPRITE_BATCH);
+		c.decal = &decal;
+		c.quads = quads;
+		c.count = count;
+	}
+
+	bool RenderList::validate() const {
+		bool layer = false;
+		for (const RenderCommand& c : commands) {
+			switch (c.type) {
+			case RenderCommand::VIEWPORT:
+			case RenderCommand::SCISSOR:
+				if (c.rect[2] < 0 || c.rect[3] < 0) return false;
+				break;
+			case RenderCommand::CLEAR:
+				break;
+			case RenderCommand::LAYER:
+				layer = true;
+				break;
+			case RenderCommand::DECAL:
+				if (!layer || c.decal == nullptr || (c.vertices == nullptr && c.decal->points > 0)) return false;
+				break;
+			case RenderCommand::DECAL_LIST:
+				if (!layer || c.list == nullptr) return false;
+				break;
+			case RenderCommand::SPRITE_BATCH:
+				if (!layer || c.decal == nullptr || c.decal->decal == nullptr || c.quads == nullptr || c.count == 0) return false;
+				break;
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void RenderList::reset() {
+		commands.clear();
+	}
+}
+#pragma endregion
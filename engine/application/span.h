@@ -0,0 +1,246 @@
+#pragma region span_kernels
+namespace engine {
+	uint32_t blend_weight(float blend) {
+		return uint32_t(std::min(1.0f, std::max(0.0f, blend)) * 256.0f + 0.5f);
+	}
+
+	Pixel blend_pixel(const Pixel& src, const Pixel& dest, uint32_t weight) {
+		// red and blue share one multiply, each lane stays below 16 bits
+		uint32_t a = ((src.a + (src.a >> 7)) * weight) >> 8;
+		uint32_t c = 256 - a;
+		uint32_t rb = ((src.n & 0x00FF00FF) * a + (dest.n & 0x00FF00FF) * c + 0x00800080) >> 8;
+		uint32_t g  = ((src.n & 0x0000FF00) * a + (dest.n & 0x0000FF00) * c + 0x00008000) >> 8;
+		return Pixel((rb & 0x00FF00FF) | (g & 0x0000FF00) | 0xFF000000);
+	}
+
+#if defined(ENGINE_SIMD_SSE2)
+	static inline __m128i simd_reverse4(__m128i v) {
+		return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	}
+
+	static inline __m128i simd_load4(const Pixel* src, int32_t step, int32_t i) {
+		if (step > 0) return _mm_loadu_si128((const __m128i*)(src + i));
+		return simd_reverse4(_mm_loadu_si128((const __m128i*)(src - i - 3)));
+	}
+
+	static inline __m128i simd_weight4(__m128i s16, uint32_t weight) {
+		__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xFF), 0xFF);
+		a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+		if (weight < 256) a = _mm_mulhi_epu16(a, _mm_set1_epi16(short(weight << 8)));
+		return a;
+	}
+
+	static inline __m128i simd_blend4(__m128i s, __m128i d, uint32_t weight) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i full = _mm_set1_epi16(256);
+		const __m128i half = _mm_set1_epi16(128);
+
+		__m128i s_lo = _mm_unpacklo_epi8(s, zero), s_hi = _mm_unpackhi_epi8(s, zero);
+		__m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+		__m128i a_lo = simd_weight4(s_lo, weight), a_hi = simd_weight4(s_hi, weight);
+
+		__m128i o_lo = _mm_add_epi16(_mm_mullo_epi16(s_lo, a_lo), _mm_mullo_epi16(d_lo, _mm_sub_epi16(full, a_lo)));
+		__m128i o_hi = _mm_add_epi16(_mm_mullo_epi16(s_hi, a_hi), _mm_mullo_epi16(d_hi, _mm_sub_epi16(full, a_hi)));
+		o_lo = _mm_srli_epi16(_mm_add_epi16(o_lo, half), 8);
+		o_hi = _mm_srli_epi16(_mm_add_epi16(o_hi, half), 8);
+		return _mm_or_si128(_mm_packus_epi16(o_lo, o_hi), _mm_set1_epi32(int(0xFF000000)));
+	}
+#endif
+
+#if defined(ENGINE_SIMD_AVX2)
+	static inline __m256i simd_load8(const Pixel* src, int32_t step, int32_t i) {
+		if (step > 0) return _mm256_loadu_si256((const __m256i*)(src + i));
+		return _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(src - i - 7)), _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+	}
+
+	static inline __m256i simd_weight8(__m256i s16, uint32_t weight) {
+		__m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, 0xFF), 0xFF);
+		a = _mm256_add_epi16(a, _mm256_srli_epi16(a, 7));
+		if (weight < 256) a = _mm256_mulhi_epu16(a, _mm256_set1_epi16(short(weight << 8)));
+		return a;
+	}
+
+	static inline __m256i simd_blend8(__m256i s, __m256i d, uint32_t weight) {
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i full = _mm256_set1_epi16(256);
+		const __m256i half = _mm256_set1_epi16(128);
+
+		__m256i s_lo = _mm256_unpacklo_epi8(s, zero), s_hi = _mm256_unpackhi_epi8(s, zero);
+		__m256i d_lo = _mm256_unpacklo_epi8(d, zero), d_hi = _mm256_unpackhi_epi8(d, zero);
+		__m256i a_lo = simd_weight8(s_lo, weight), a_hi = simd_weight8(s_hi, weight);
+
+		__m256i o_lo = _mm256_add_epi16(_mm256_mullo_epi16(s_lo, a_lo), _mm256_mullo_epi16(d_lo, _mm256_sub_epi16(full, a_lo)));
+		__m256i o_hi = _mm256_add_epi16(_mm256_mullo_epi16(s_hi, a_hi), _mm256_mullo_epi16(d_hi, _mm256_sub_epi16(full, a_hi)));
+		o_lo = _mm256_srli_epi16(_mm256_add_epi16(o_lo, half), 8);
+		o_hi = _mm256_srli_epi16(_mm256_add_epi16(o_hi, half), 8);
+		return _mm256_or_si256(_mm256_packus_epi16(o_lo, o_hi), _mm256_set1_epi32(int(0xFF000000)));
+	}
+#endif
+
+#if defined(ENGINE_SIMD_NEON)
+	static inline uint32x4_t simd_reverse4(uint32x4_t v) {
+		uint32x4_t r = vrev64q_u32(v);
+		return vextq_u32(r, r, 2);
+	}
+
+	static inline uint32x4_t simd_load4(const Pixel* src, int32_t step, int32_t i) {
+		if (step > 0) return vld1q_u32((const uint32_t*)(src + i));
+		return simd_reverse4(vld1q_u32((const uint32_t*)(src - i - 3)));
+	}
+
+	static inline uint8x8x4_t simd_load8_planar(const Pixel* src, int32_t step, int32_t i) {
+		if (step > 0) return vld4_u8((const uint8_t*)(src + i));
+		uint32_t tmp[8];
+		vst1q_u32(tmp + 0, simd_load4(src, step, i));
+		vst1q_u32(tmp + 4, simd_load4(src, step, i + 4));
+		return vld4_u8((const uint8_t*)tmp);
+	}
+
+	static inline uint8x8x4_t simd_blend8_planar(const uint8x8x4_t& s, const uint8x8x4_t& d, uint32_t weight) {
+		uint16x8_t a = vmovl_u8(s.val[3]);
+		a = vaddq_u16(a, vshrq_n_u16(a, 7));
+		if (weight < 256) a = vshrq_n_u16(vmulq_n_u16(a, uint16_t(weight)), 8);
+		uint16x8_t c = vsubq_u16(vdupq_n_u16(256), a);
+
+		uint8x8x4_t o;
+		for (int ch = 0; ch < 3; ch++) {
+			uint16x8_t v = vmlaq_u16(vmulq_u16(vmovl_u8(s.val[ch]), a), vmovl_u8(d.val[ch]), c);
+			o.val[ch] = vshrn_n_u16(vaddq_u16(v, vdupq_n_u16(128)), 8);
+		}
+		o.val[3] = vdup_n_u8(255);
+		return o;
+	}
+#endif
+
+	// fills at least this many pixels long use non-temporal stores, the
+	// destination would be evicted from the cache before it is read again
+	static constexpr int32_t span_stream_count = 1 << 20;
+
+	void span_fill(Pixel* dest, const Pixel& src, int32_t count) {
+		int32_t i = 0;
+#if defined(ENGINE_SIMD_SSE2)
+		const __m128i s4 = _mm_set1_epi32(int(src.n));
+		if (count >= span_stream_count) {
+			for (; i < count && (uintptr_t(dest + i) & 15); i++) dest[i] = src;
+			for (; i + 4 <= count; i += 4)
+				_mm_stream_si128((__m128i*)(dest + i), s4);
+			_mm_sfence();
+		}
+#endif
+#if defined(ENGINE_SIMD_AVX2)
+		const __m256i s8 = _mm256_set1_epi32(int(src.n));
+		for (; i + 8 <= count; i += 8)
+			_mm256_storeu_si256((__m256i*)(dest + i), s8);
+#endif
+#if defined(ENGINE_SIMD_SSE2)
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_si128((__m128i*)(dest + i), s4);
+#elif defined(ENGINE_SIMD_NEON)
+		const uint32x4_t s4 = vdupq_n_u32(src.n);
+		for (; i + 4 <= count; i += 4)
+			vst1q_u32((uint32_t*)(dest + i), s4);
+#endif
+		for (; i < count; i++) dest[i] = src;
+	}
+
+	void span_copy(Pixel* dest, const Pixel* src, int32_t step, int32_t count) {
+		if (step > 0) {
+			std::memcpy(dest, src, count * sizeof(Pixel));
+			return;
+		}
+
+		int32_t i = 0;
+#if defined(ENGINE_SIMD_SSE2)
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_si128((__m128i*)(dest + i), simd_load4(src, step, i));
+#elif defined(ENGINE_SIMD_NEON)
+		for (; i + 4 <= count; i += 4)
+			vst1q_u32((uint32_t*)(dest + i), simd_load4(src, step, i));
+#endif
+		for (; i < count; i++) dest[i] = src[-i];
+	}
+
+	void span_mask(Pixel* dest, const Pixel* src, int32_t step, int32_t count) {
+		int32_t i = 0;
+#if defined(ENGINE_SIMD_AVX2)
+		const __m256i am8 = _mm256_set1_epi32(int(0xFF000000));
+		for (; i + 8 <= count; i += 8) {
+			__m256i s = simd_load8(src, step, i);
+			__m256i d = _mm256_loadu_si256((const __m256i*)(dest + i));
+			__m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(s, am8), am8);
+			_mm256_storeu_si256((__m256i*)(dest + i), _mm256_blendv_epi8(d, s, m));
+		}
+#endif
+#if defined(ENGINE_SIMD_SSE2)
+		const __m128i am4 = _mm_set1_epi32(int(0xFF000000));
+		for (; i + 4 <= count; i += 4) {
+			__m128i s = simd_load4(src, step, i);
+			__m128i d = _mm_loadu_si128((const __m128i*)(dest + i));
+			__m128i m = _mm_cmpeq_epi32(_mm_and_si128(s, am4), am4);
+			_mm_storeu_si128((__m128i*)(dest + i), _mm_or_si128(_mm_and_si128(m, s), _mm_andnot_si128(m, d)));
+		}
+#elif defined(ENGINE_SIMD_NEON)
+		const uint32x4_t am4 = vdupq_n_u32(0xFF000000);
+		for (; i + 4 <= count; i += 4) {
+			uint32x4_t s = simd_load4(src, step, i);
+			uint32x4_t d = vld1q_u32((const uint32_t*)(dest + i));
+			uint32x4_t m = vceqq_u32(vandq_u32(s, am4), am4);
+			vst1q_u32((uint32_t*)(dest + i), vbslq_u32(m, s, d));
+		}
+#endif
+		for (; i < count; i++) {
+			const Pixel& p = src[i * step];
+			if (p.a == 255) dest[i] = p;
+		}
+	}
+
+	void span_blend(Pixel* dest, const Pixel* src, int32_t step, int32_t count, uint32_t weight) {
+		int32_t i = 0;
+#if defined(ENGINE_SIMD_AVX2)
+		for (; i + 8 <= count; i += 8) {
+			__m256i d = _mm256_loadu_si256((const __m256i*)(dest + i));
+			_mm256_storeu_si256((__m256i*)(dest + i), simd_blend8(simd_load8(src, step, i), d, weight));
+		}
+#endif
+#if defined(ENGINE_SIMD_SSE2)
+		for (; i + 4 <= count; i += 4) {
+			__m128i d = _mm_loadu_si128((const __m128i*)(dest + i));
+			_mm_storeu_si128((__m128i*)(dest + i), simd_blend4(simd_load4(src, step, i), d, weight));
+		}
+#elif defined(ENGINE_SIMD_NEON)
+		for (; i + 8 <= count; i += 8) {
+			uint8x8x4_t d = vld4_u8((const uint8_t*)(dest + i));
+			vst4_u8((uint8_t*)(dest + i), simd_blend8_planar(simd_load8_planar(src, step, i), d, weight));
+		}
+#endif
+		for (; i < count; i++) dest[i] = blend_pixel(src[i * step], dest[i], weight);
+	}
+
+	void span_blend_solid(Pixel* dest, const Pixel& src, int32_t count, uint32_t weight) {
+		int32_t i = 0;
+#if defined(ENGINE_SIMD_AVX2)
+		const __m256i s8 = _mm256_set1_epi32(int(src.n));
+		for (; i + 8 <= count; i += 8) {
+			__m256i d = _mm256_loadu_si256((const __m256i*)(dest + i));
+			_mm256_storeu_si256((__m256i*)(dest + i), simd_blend8(s8, d, weight));
+		}
+#endif
+#if defined(ENGINE_SIMD_SSE2)
+		const __m128i s4 = _mm_set1_epi32(int(src.n));
+		for (; i + 4 <= count; i += 4) {
+			__m128i d = _mm_loadu_si128((const __m128i*)(dest + i));
+			_mm_storeu_si128((__m128i*)(dest + i), simd_blend4(s4, d, weight));
+		}
+#elif defined(ENGINE_SIMD_NEON)
+		uint8x8x4_t s8;
+		s8.val[0] = vdup_n_u8(src.r); s8.val[1] = vdup_n_u8(src.g);
+		s8.val[2] = vdup_n_u8(src.b); s8.val[3] = vdup_n_u8(src.a);
+		for (; i + 8 <= count; i += 8) {
+			uint8x8x4_t d = vld4_u8((const uint8_t*)(dest + i));
+			vst4_u8((uint8_t*)(dest + i), simd_blend8_planar(s8, d, weight));
+		}
+#endif
+		for (; i < count; i++) dest[i] = blend_pixel(src, dest[i], weight);
+	}
+}
+#pragma endregion
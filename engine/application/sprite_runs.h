@@ -0,0 +1,44 @@
+#pragma region sprite_runs
+namespace engine {
+	void Sprite::enable_compiled(bool enable) {
+		compiled = enable;
+		runs.clear();
+		row_runs.clear();
+		runs_version = Version();
+	}
+
+	void Sprite::update_compiled() {
+		// indexed sprites keep no alpha per pixel to build runs from
+		if (!compiled || palette != nullptr || runs_version == version())
+			return;
+		runs_version = version();
+
+		runs.clear();
+		row_runs.assign(size_t(std::max(height, 0)) + 1, 0);
+		for (int32_t y = 0; y < height; y++) {
+			const Pixel* row = col_data.data() + y * pitch;
+			for (int32_t x = 0; x < width;) {
+				uint8_t a = row[x].a;
+				int32_t end = x + 1;
+				if (a == 0) {
+					while (end < width && row[end].a == 0) end++;
+				}
+				else {
+					bool opaque = (a == 255);
+					while (end < width && row[end].a != 0 && (row[end].a == 255) == opaque) end++;
+					runs.push_back({ x, end - x, opaque });
+				}
+				x = end;
+			}
+			row_runs[y + 1] = uint32_t(runs.size());
+		}
+	}
+
+	bool Sprite::is_compiled() const { return compiled && palette == nullptr && runs_version == version() && !row_runs.empty(); }
+
+	const Sprite::Run* Sprite::get_runs(int32_t y, int32_t& count) const {
+		count = int32_t(row_runs[y + 1] - row_runs[y]);
+		return runs.data() + row_runs[y];
+	}
+}
+#pragma endregion
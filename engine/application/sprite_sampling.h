@@ -0,0 +1,206 @@
+#pragma region sprite_sampling
+namespace engine {
+	// samples are processed in chunks this long, so the scratch space stays on the stack
+	static constexpr int32_t sample_chunk = 64;
+
+	// (a * (256 - f) + b * f) / 256 for every channel, two channels per multiply; f is 0..256
+	static inline uint32_t sample_lerp(uint32_t a, uint32_t b, uint32_t f) {
+		uint32_t rb = ((a & 0x00FF00FF) * (256 - f) + (b & 0x00FF00FF) * f + 0x00800080) >> 8;
+		uint32_t ga = (((a >> 8) & 0x00FF00FF) * (256 - f) + ((b >> 8) & 0x00FF00FF) * f + 0x00800080) >> 8;
+		return (rb & 0x00FF00FF) | ((ga & 0x00FF00FF) << 8);
+	}
+
+#if defined(ENGINE_SIMD_SSE2)
+	// a and b hold two pixels as 16 bit channels, f holds each pixel's weight in all four of its channels
+	static inline __m128i simd_lerp2(__m128i a, __m128i b, __m128i f) {
+		__m128i o = _mm_add_epi16(_mm_mullo_epi16(a, _mm_sub_epi16(_mm_set1_epi16(256), f)), _mm_mullo_epi16(b, f));
+		return _mm_srli_epi16(_mm_add_epi16(o, _mm_set1_epi16(128)), 8);
+	}
+#endif
+
+	static void sample_lerp(const uint32_t* a, const uint32_t* b, const uint32_t* f, uint32_t* out, int32_t count) {
+		int32_t i = 0;
+#if defined(ENGINE_SIMD_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 4 <= count; i += 4) {
+			__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+			__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+			__m128i vf = _mm_loadu_si128((const __m128i*)(f + i));
+			__m128i f_lo = _mm_unpacklo_epi32(vf, vf), f_hi = _mm_unpackhi_epi32(vf, vf);
+			f_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f_lo, 0), 0);
+			f_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(f_hi, 0), 0);
+			__m128i lo = simd_lerp2(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero), f_lo);
+			__m128i hi = simd_lerp2(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero), f_hi);
+			_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi16(lo, hi));
+		}
+#elif defined(ENGINE_SIMD_NEON)
+		const uint16x8_t full = vdupq_n_u16(256);
+		const uint16x8_t half = vdupq_n_u16(128);
+		for (; i + 4 <= count; i += 4) {
+			uint8x16_t va = vreinterpretq_u8_u32(vld1q_u32(a + i));
+			uint8x16_t vb = vreinterpretq_u8_u32(vld1q_u32(b + i));
+			uint16x4_t f4 = vmovn_u32(vld1q_u32(f + i));
+			uint16x8_t f_lo = vcombine_u16(vdup_lane_u16(f4, 0), vdup_lane_u16(f4, 1));
+			uint16x8_t f_hi = vcombine_u16(vdup_lane_u16(f4, 2), vdup_lane_u16(f4, 3));
+			uint16x8_t lo = vmlaq_u16(vmulq_u16(vmovl_u8(vget_low_u8(va)), vsubq_u16(full, f_lo)), vmovl_u8(vget_low_u8(vb)), f_lo);
+			uint16x8_t hi = vmlaq_u16(vmulq_u16(vmovl_u8(vget_high_u8(va)), vsubq_u16(full, f_hi)), vmovl_u8(vget_high_u8(vb)), f_hi);
+			uint8x16_t o = vcombine_u8(vshrn_n_u16(vaddq_u16(lo, half), 8), vshrn_n_u16(vaddq_u16(hi, half), 8));
+			vst1q_u32(out + i, vreinterpretq_u32_u8(o));
+		}
+#endif
+		for (; i < count; i++) out[i] = sample_lerp(a[i], b[i], f[i]);
+	}
+
+	// texel index along one axis, wrapped or clamped to the edge
+	static inline int32_t sample_wrap(int32_t t, int32_t size, bool periodic) {
+		if (periodic) {
+			t %= size;
+			return (t < 0) ? t + size : t;
+		}
+		return std::min(std::max(t, 0), size - 1);
+	}
+
+	// Bilinear samples of one level. The sample mode decides the edges: PERIODIC wraps,
+	// CLAMP clamps and NORMAL clamps as well but is blank outside the sprite.
+	void Sprite::sample_level(int32_t level, const float* u, const float* v, uint32_t* out, int32_t count) const {
+		// indexed sprites only hold indices at the top level
+		const uint8_t* indices = (level == 0 && palette != nullptr) ? index_data.data() : nullptr;
+		const uint32_t* colours = (indices != nullptr) ? &palette->colours[0].n : nullptr;
+		const Pixel* data = (level == 0) ? col_data.data() : mip_levels[level - 1].data.data();
+		int32_t w = (level == 0) ? width : mip_levels[level - 1].width;
+		int32_t h = (level == 0) ? height : mip_levels[level - 1].height;
+		int32_t stride = (level == 0) ? pitch : w;
+		if (w <= 0 || h <= 0 || (data == nullptr && indices == nullptr)) {
+			std::fill(out, out + count, 0u);
+			return;
+		}
+
+		constexpr float limit = float(1 << 24);
+		bool periodic = (sample_mode == Mode::PERIODIC);
+		bool bounded = (sample_mode == Mode::NORMAL);
+
+		uint32_t t[4][sample_chunk], fx[sample_chunk], fy[sample_chunk];
+		for (int32_t i = 0; i < count; i += sample_chunk) {
+			int32_t n = std::min(sample_chunk, count - i);
+			for (int32_t k = 0; k < n; k++) {
+				float su = u[i + k], sv = v[i + k];
+				float x = std::min(limit, std::max(-limit, su * float(w) - 0.5f));
+				float y = std::min(limit, std::max(-limit, sv * float(h) - 0.5f));
+				float xf = std::floor(x), yf = std::floor(y);
+				fx[k] = uint32_t((x - xf) * 256.0f + 0.5f);
+				fy[k] = uint32_t((y - yf) * 256.0f + 0.5f);
+
+				int32_t x0 = sample_wrap(int32_t(xf), w, periodic), x1 = sample_wrap(int32_t(xf) + 1, w, periodic);
+				int32_t y0 = sample_wrap(int32_t(yf), h, periodic) * stride, y1 = sample_wrap(int32_t(yf) + 1, h, periodic) * stride;
+				bool blank = bounded && !(su >= 0.0f && su <= 1.0f && sv >= 0.0f && sv <= 1.0f);
+				if (blank) {
+					t[0][k] = t[1][k] = t[2][k] = t[3][k] = 0;
+				}
+				else if (indices != nullptr) {
+					t[0][k] = colours[indices[y0 + x0]];
+					t[1][k] = colours[indices[y0 + x1]];
+					t[2][k] = colours[indices[y1 + x0]];
+					t[3][k] = colours[indices[y1 + x1]];
+				}
+				else {
+					t[0][k] = data[y0 + x0].n;
+					t[1][k] = data[y0 + x1].n;
+					t[2][k] = data[y1 + x0].n;
+					t[3][k] = data[y1 + x1].n;
+				}
+			}
+
+			sample_lerp(t[0], t[1], fx, t[0], n);
+			sample_lerp(t[2], t[3], fx, t[2], n);
+			sample_lerp(t[0], t[2], fy, out + i, n);
+		}
+	}
+
+	void Sprite::sample_BL(const float* u, const float* v, Pixel* out, int32_t count) const {
+		if (count > 0)
+			sample_level(0, u, v, &out->n, count);
+	}
+
+	void Sprite::sample_TL(const float* u, const float* v, const float* lod, Pixel* out, int32_t count) const {
+		int32_t top = mip_count() - 1;
+		auto level_of = [top](float l) { return (l > 0.0f) ? std::min(int32_t(std::min(l, 30.0f)), top) : 0; };
+
+		// runs of samples on the same level are filtered together
+		uint32_t upper[sample_chunk], weight[sample_chunk];
+		for (int32_t i = 0; i < count;) {
+			int32_t level = level_of(lod[i]);
+			int32_t n = 1;
+			while (i + n < count && n < sample_chunk && level_of(lod[i + n]) == level) n++;
+
+			uint32_t* dest = &out[i].n;
+			sample_level(level, u + i, v + i, dest, n);
+			if (level < top) {
+				uint32_t blend = 0;
+				for (int32_t k = 0; k < n; k++) {
+					weight[k] = uint32_t(std::min(1.0f, std::max(0.0f, lod[i + k] - float(level))) * 256.0f + 0.5f);
+					blend |= weight[k];
+				}
+				if (blend != 0) {
+					sample_level(level + 1, u + i, v + i, upper, n);
+					sample_lerp(dest, upper, weight, dest, n);
+				}
+			}
+			i += n;
+		}
+	}
+
+	void Sprite::enable_mipmaps(bool enable) {
+		mipmaps = enable;
+		mip_levels.clear();
+		mip_version = Version();
+	}
+
+	void Sprite::update_mipmaps() {
+		if (!mipmaps || mip_version == version())
+			return;
+		mip_version = version();
+
+		size_t levels = 0;
+		for (int32_t w = width, h = height; w > 1 || h > 1; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+			levels++;
+		if (width <= 0 || height <= 0)
+			levels = 0;
+		mip_levels.resize(levels);
+
+		// every level averages 2x2 blocks of the one above, the last row and column repeat on odd sizes
+		std::vector<Pixel> expanded;
+		if (palette != nullptr) {
+			expanded.resize(index_data.size());
+			expand(expanded.data());
+		}
+		const Pixel* src = (palette != nullptr) ? expanded.data() : col_data.data();
+		int32_t w = width, h = height, stride = pitch;
+		for (MipLevel& m : mip_levels) {
+			m.width = std::max(w / 2, 1);
+			m.height = std::max(h / 2, 1);
+			m.data.resize(size_t(m.width) * size_t(m.height));
+
+			for (int32_t y = 0; y < m.height; y++) {
+				const Pixel* r0 = src + std::min(y * 2, h - 1) * stride;
+				const Pixel* r1 = src + std::min(y * 2 + 1, h - 1) * stride;
+				for (int32_t x = 0; x < m.width; x++) {
+					int32_t x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+					uint32_t p[4] = { r0[x0].n, r0[x1].n, r1[x0].n, r1[x1].n };
+					uint32_t rb = 0x00020002, ga = 0x00020002;
+					for (int k = 0; k < 4; k++) {
+						rb += p[k] & 0x00FF00FF;
+						ga += (p[k] >> 8) & 0x00FF00FF;
+					}
+					m.data[y * m.width + x].n = ((rb >> 2) & 0x00FF00FF) | (((ga >> 2) & 0x00FF00FF) << 8);
+				}
+			}
+
+			src = m.data.data();
+			w = stride = m.width;
+			h = m.height;
+		}
+	}
+
+	int32_t Sprite::mip_count() const { return int32_t(mip_levels.size()) + 1; }
+}
+#pragma endregion
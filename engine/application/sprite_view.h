@@ -0,0 +1,102 @@
+#pragma region sprite_view
+namespace engine {
+	SpriteView::SpriteView(engine::Sprite* sprite) : sprite(sprite) {
+		if (sprite != nullptr) {
+			width = sprite->width;
+			height = sprite->height;
+		}
+	}
+
+	SpriteView::SpriteView(engine::Sprite* sprite, int32_t x, int32_t y, int32_t w, int32_t h) : sprite(sprite) {
+		if (sprite == nullptr)
+			return;
+		this->x = std::min(std::max(x, 0), sprite->width);
+		this->y = std::min(std::max(y, 0), sprite->height);
+		width = std::max(0, std::min(x + w, sprite->width) - this->x);
+		height = std::max(0, std::min(y + h, sprite->height) - this->y);
+	}
+
+	SpriteView SpriteView::sub(int32_t sx, int32_t sy, int32_t w, int32_t h) const {
+		int32_t x1 = std::min(std::max(sx, 0), width), y1 = std::min(std::max(sy, 0), height);
+		int32_t x2 = std::min(std::max(sx + w, x1), width), y2 = std::min(std::max(sy + h, y1), height);
+		return SpriteView(sprite, x + x1, y + y1, x2 - x1, y2 - y1);
+	}
+
+	int32_t SpriteView::pitch() const { return (sprite != nullptr) ? sprite->pitch : 0; }
+
+	Pixel* SpriteView::get_data() {
+		return (sprite != nullptr) ? sprite->get_data() + y * sprite->pitch + x : nullptr;
+	}
+
+	const Pixel* SpriteView::get_data() const {
+		return (sprite != nullptr) ? static_cast<const engine::Sprite*>(sprite)->get_data() + y * sprite->pitch + x : nullptr;
+	}
+
+	Pixel SpriteView::get_pixel(int32_t px, int32_t py) const {
+		if (sprite == nullptr || width <= 0 || height <= 0)
+			return Pixel(0, 0, 0, 0);
+
+		if (sprite->sample_mode == engine::Sprite::Mode::NORMAL) {
+			if (px < 0 || px >= width || py < 0 || py >= height)
+				return Pixel(0, 0, 0, 0);
+		}
+		else if (sprite->sample_mode == engine::Sprite::Mode::PERIODIC) {
+			px = abs(px % width);
+			py = abs(py % height);
+		}
+		else {
+			px = sample_wrap(px, width, false);
+			py = sample_wrap(py, height, false);
+		}
+		return sprite->get_pixel(x + px, y + py);
+	}
+
+	bool SpriteView::set_pixel(int32_t px, int32_t py, Pixel p) {
+		if (sprite == nullptr || px < 0 || px >= width || py < 0 || py >= height)
+			return false;
+		return sprite->set_pixel(x + px, y + py, p);
+	}
+
+	Pixel SpriteView::sample(float u, float v) const {
+		int32_t sx = std::min((int32_t)((u * (float)width)), width - 1);
+		int32_t sy = std::min((int32_t)((v * (float)height)), height - 1);
+		return get_pixel(sx, sy);
+	}
+
+	Pixel SpriteView::sample(const engine::float_vector_2d& uv) const { return sample(uv.x, uv.y); }
+
+	// same filter as Sprite::sample_BL, with the four texels fetched through the view's edges
+	Pixel SpriteView::sample_BL(float u, float v) const {
+		if (sprite == nullptr || width <= 0 || height <= 0)
+			return Pixel(0, 0, 0, 0);
+		if (sprite->sample_mode == engine::Sprite::Mode::NORMAL && !(u >= 0.0f && u <= 1.0f && v >= 0.0f && v <= 1.0f))
+			return Pixel(0, 0, 0, 0);
+
+		constexpr float limit = float(1 << 24);
+		float fx = std::min(limit, std::max(-limit, u * float(width) - 0.5f));
+		float fy = std::min(limit, std::max(-limit, v * float(height) - 0.5f));
+		float xf = std::floor(fx), yf = std::floor(fy);
+		uint32_t wx = uint32_t((fx - xf) * 256.0f + 0.5f), wy = uint32_t((fy - yf) * 256.0f + 0.5f);
+
+		// NORMAL clamps between the texels, like Sprite::sample_BL does inside the sprite
+		bool periodic = (sprite->sample_mode == engine::Sprite::Mode::PERIODIC);
+		int32_t x0 = sample_wrap(int32_t(xf), width, periodic), x1 = sample_wrap(int32_t(xf) + 1, width, periodic);
+		int32_t y0 = sample_wrap(int32_t(yf), height, periodic), y1 = sample_wrap(int32_t(yf) + 1, height, periodic);
+		uint32_t top = sample_lerp(sprite->get_pixel(x + x0, y + y0).n, sprite->get_pixel(x + x1, y + y0).n, wx);
+		uint32_t bottom = sample_lerp(sprite->get_pixel(x + x0, y + y1).n, sprite->get_pixel(x + x1, y + y1).n, wx);
+		Pixel p;
+		p.n = sample_lerp(top, bottom, wy);
+		return p;
+	}
+
+	Pixel SpriteView::sample_BL(const engine::float_vector_2d& uv) const { return sample_BL(uv.x, uv.y); }
+
+	engine::Sprite* SpriteView::duplicate() const {
+		if (sprite == nullptr)
+			return nullptr;
+		return sprite->duplicate({ x, y }, { width, height });
+	}
+
+	engine::int_vector_2d SpriteView::size() const { return { width, height }; }
+}
+#pragma endregion
@@ -0,0 +1,94 @@
+#pragma region tile_raster
+namespace engine {
+	TileRaster::TileRaster(uint32_t worker_count, int32_t size) {
+		tile_size = std::max(size, 8);
+		for (uint32_t i = 0; i < worker_count; i++)
+			workers.emplace_back(&TileRaster::worker_loop, this);
+	}
+
+	TileRaster::~TileRaster() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (auto& t : workers) t.join();
+	}
+
+	void TileRaster::bin(const std::vector<DrawCommand>& commands, int32_t width, int32_t height) {
+		tiles_x = (width + tile_size - 1) / tile_size;
+		tiles_y = (height + tile_size - 1) / tile_size;
+		bins.resize(size_t(tiles_x) * size_t(tiles_y));
+		for (auto& b : bins) b.clear();
+
+		for (uint32_t i = 0; i < uint32_t(commands.size()); i++) {
+			const DrawCommand& c = commands[i];
+			if (c.x1 >= c.x2 || c.y1 >= c.y2)
+				continue;
+
+			int32_t ty1 = c.y1 / tile_size, ty2 = (c.y2 - 1) / tile_size;
+			for (int32_t ty = ty1; ty <= ty2; ty++) {
+				int32_t x1 = c.x1, x2 = c.x2;
+
+				// lines only visit the tiles along their path, not their whole bounding box
+				if (c.type == DrawCommand::LINE && c.v[1] != c.v[3]) {
+					float dxdy = float(c.v[2] - c.v[0]) / float(c.v[3] - c.v[1]);
+					float ya = float(std::max(c.y1, ty * tile_size) - 1 - c.v[1]);
+					float yb = float(std::min(c.y2, (ty + 1) * tile_size) - c.v[1]);
+					float xa = float(c.v[0]) + ya * dxdy, xb = float(c.v[0]) + yb * dxdy;
+					if (xa > xb) std::swap(xa, xb);
+					xa = std::max(xa, float(c.x1 - 2));
+					xb = std::min(xb, float(c.x2 + 2));
+					x1 = std::max(x1, int32_t(std::floor(xa)) - 1);
+					x2 = std::min(x2, int32_t(std::ceil(xb)) + 2);
+					if (x1 >= x2) continue;
+				}
+
+				int32_t tx1 = x1 / tile_size, tx2 = (x2 - 1) / tile_size;
+				for (int32_t tx = tx1; tx <= tx2; tx++)
+					bins[ty * tiles_x + tx].push_back(i);
+			}
+		}
+	}
+
+	void TileRaster::run(int32_t count, const std::function<void(int32_t)>& job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = &job;
+			task_count = count;
+			next = 0;
+			busy = uint32_t(workers.size());
+			generation++;
+		}
+		wake.notify_all();
+
+		// the calling thread takes tiles as well
+		work();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return busy == 0; });
+		task = nullptr;
+	}
+
+	void TileRaster::work() {
+		for (int32_t i = next++; i < task_count; i = next++)
+			(*task)(i);
+	}
+
+	void TileRaster::worker_loop() {
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			wake.wait(lock, [&] { return quit || generation != seen; });
+			if (quit)
+				return;
+
+			seen = generation;
+			lock.unlock();
+			work();
+			lock.lock();
+			if (--busy == 0) done.notify_one();
+		}
+	}
+}
+#pragma endregion
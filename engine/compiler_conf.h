@@ -34,6 +34,37 @@
 
 #define UNUSED(x) (void)(x)
 
+// Marks Engine::draw final. Primitives then write the draw target directly with the pixel
+// mode resolved once per primitive. Without it draw can be overridden, and every pixel the
+// primitives write goes through it, in order on the calling thread.
+#if defined(ENGINE_FINAL_DRAW)
+	#define ENGINE_DRAW_FINAL final
+#else
+	#define ENGINE_DRAW_FINAL
+#endif
+
+#if !defined(ENGINE_SIMD_NONE)
+	#if defined(__AVX2__)
+		#define ENGINE_SIMD_AVX2
+	#endif
+	#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define ENGINE_SIMD_SSE2
+	#endif
+	#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		#define ENGINE_SIMD_NEON
+	#endif
+#endif
+
+#if defined(ENGINE_SIMD_AVX2)
+	#include <immintrin.h>
+#elif defined(ENGINE_SIMD_SSE2)
+	#include <emmintrin.h>
+#endif
+
+#if defined(ENGINE_SIMD_NEON)
+	#include <arm_neon.h>
+#endif
+
 #if defined(ENGINE_PGE_HEADLESS)
 	#define ENGINE_PLATFORM_HEADLESS
 	#define ENGINE_GFX_HEADLESS
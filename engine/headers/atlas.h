@@ -0,0 +1,59 @@
+#ifndef ATLAS_DEF
+#define ATLAS_DEF
+
+// Packs many sprites into shared pages, so tiles drawn from one page share a
+// texture and can be drawn without rebinding. Each page is a skyline packer:
+// a page starts small and doubles up to max_size, after which a new page is
+// opened. Regions never move, so handles stay valid while the atlas lives.
+// A page stops growing once its decal has been handed out: decals already
+// drawn from it keep UVs for its size, so later regions open a new page.
+class Atlas {
+public:
+	struct Region {
+		uint32_t page;
+		int32_t  x, y, w, h;
+	};
+
+	Atlas(int32_t max_size = 2048, int32_t padding = 1, bool filter = false);
+	Atlas(const Atlas&) = delete;
+
+	// Copies the pixels in and returns the handle of their region, or -1 when
+	// they cannot fit on a page.
+	int32_t add(const engine::Sprite* sprite);
+	int32_t add(const engine::Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h);
+
+	// Uploads the pages changed since the last call, creating their decals first.
+	void update();
+
+	// false for -1 and any other handle add() did not return
+	bool            has_region(int32_t handle) const;
+	const Region&   get_region(int32_t handle) const;
+	engine::Sprite* get_sprite(uint32_t page) const;
+	engine::Decal*  get_decal (uint32_t page) const;
+	uint32_t        page_count() const;
+
+private:
+	struct Segment {
+		int32_t x, y, w;
+	};
+
+	struct Page {
+		std::unique_ptr<engine::Sprite> sprite;
+		std::unique_ptr<engine::Decal>  decal;
+		std::vector<Segment> skyline;
+		bool dirty = true;
+		// set by get_decal(), the page keeps its size from then on
+		mutable bool drawn = false;
+	};
+
+	bool place(Page& page, int32_t w, int32_t h, int32_t& x, int32_t& y);
+	bool grow (Page& page);
+
+	std::vector<Page>   pages;
+	std::vector<Region> regions;
+	int32_t max_size;
+	int32_t padding;
+	bool    filter;
+};
+
+#endif
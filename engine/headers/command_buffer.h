@@ -0,0 +1,78 @@
+#ifndef COMMAND_BUFFER_DEF
+#define COMMAND_BUFFER_DEF
+
+// One software draw call. The integer parameters are laid out per type:
+//   PLOT              x, y
+//   LINE              x1, y1, x2, y2              flags = pattern
+//   LINE_AA           pos[0], pos[1]
+//   CIRCLE            x, y, radius                flags = mask
+//   FILL_CIRCLE       x, y, radius
+//   FILL_RECT         x, y, w, h
+//   FILL_TRIANGLE     x1, y1, x2, y2, x3, y3
+//   TEXTURED_TRIANGLE pos, uv, tint, depth, sprite  flags = perspective, v = view x, y, w, h
+//   SPRITE            x, y, ox, oy, w, h, dw, dh  flip, sprite
+//   STRING            x, y                        flags = scale, text
+//   STRING_PROP       x, y                        flags = scale, text
+//   CLEAR             -
+struct DrawCommand {
+	enum Type {
+		PLOT,
+		LINE,
+		LINE_AA,
+		CIRCLE,
+		FILL_CIRCLE,
+		FILL_RECT,
+		FILL_TRIANGLE,
+		TEXTURED_TRIANGLE,
+		SPRITE,
+		STRING,
+		STRING_PROP,
+		CLEAR
+	};
+
+	DrawCommand() = default;
+	DrawCommand(Type t, Pixel::Mode m, uint32_t w, Pixel p) : type(t), mode(m), weight(w), col(p) {}
+
+	Type        type = PLOT;
+	Pixel::Mode mode = Pixel::NORMAL;
+	uint32_t    weight = 256;
+	Pixel       col;
+	int32_t     v[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	uint32_t    flags = 0;
+	uint8_t     flip = 0;
+
+	const engine::Sprite* sprite = nullptr;
+	const std::string*    text = nullptr;
+
+	engine::float_vector_2d pos[3];
+	engine::float_vector_2d uv[3];
+	Pixel                   tint[3];
+	float                   depth[3] = { 1.0f, 1.0f, 1.0f };
+
+	// pixels touched, clipped to the draw target, half open
+	int32_t x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+	// the clip rectangle when the command was recorded, half open
+	int32_t clip_x1 = 0, clip_y1 = 0, clip_x2 = 0, clip_y2 = 0;
+};
+
+// Software draw calls recorded for deferred execution. Commands keep
+// pointers to their sprites, which must stay unchanged until the buffer is
+// flushed: by flush_draw(), by a change of draw target or before the layers
+// are uploaded at the end of the frame.
+class CommandBuffer {
+public:
+	// Drops commands hidden by a later opaque fill, then merges adjacent
+	// fills and adjacent blits from the same sprite.
+	void optimize();
+	void reset();
+
+	std::vector<DrawCommand> commands;
+	std::deque<std::string> strings;
+
+private:
+	bool merge(DrawCommand& last, const DrawCommand& c) const;
+
+	std::vector<uint8_t> hidden;
+};
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef COMPOSE_DEF
+#define COMPOSE_DEF
+
+// Compositing between sprites, without an Engine or a draw target. Positions are
+// relative to the destination view and writes stay inside it. These run on the
+// same kernels as drawing and keep no shared state, so worker threads can compose
+// into different sprites at once. Sources are only read: their compiled runs are
+// used when up to date but never built here. Indexed destinations need their
+// palette's update() called after it last changed.
+//
+// mode is NORMAL, MASK or ALPHA, with blend as the ALPHA weight; custom blend
+// functions go through blend().
+void blit       (SpriteView dest, int32_t x, int32_t y, const SpriteView& src, Pixel::Mode mode = Pixel::NORMAL, float blend = 1.0f, uint8_t flip = engine::Sprite::NONE);
+void blit_scaled(SpriteView dest, int32_t x, int32_t y, int32_t w, int32_t h, const SpriteView& src, Pixel::Mode mode = Pixel::NORMAL, float blend = 1.0f, uint8_t flip = engine::Sprite::NONE);
+void fill       (SpriteView dest, Pixel p, Pixel::Mode mode = Pixel::NORMAL, float blend = 1.0f);
+void blend      (SpriteView dest, int32_t x, int32_t y, const SpriteView& src, const std::function<Pixel(const int x, const int y, const Pixel&, const Pixel&)>& func);
+
+// Copies the texels as they are, alpha included, a row at a time. Both sprites
+// must store the same kind of texel: RGBA, or indices of the same palette.
+void copy_rect  (SpriteView dest, int32_t x, int32_t y, const SpriteView& src);
+
+#endif
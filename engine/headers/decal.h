@@ -14,6 +14,12 @@ public:
 	int32_t id = -1;
 	engine::Sprite* sprite = nullptr;
 	engine::float_vector_2d UV_scale = { 1.0f, 1.0f };
+
+private:
+	// what the texture holds, so update() uploads only what changed since
+	engine::int_vector_2d uploaded_size = { 0, 0 };
+	uint32_t uploaded_revision = 0;
+	uint32_t uploaded_palette = 0;
 };
 
 #endif
\ No newline at end of file
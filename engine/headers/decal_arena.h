@@ -0,0 +1,28 @@
+#ifndef DECAL_ARENA_DEF
+#define DECAL_ARENA_DEF
+
+struct DecalVertex {
+	engine::float_vector_2d pos;
+	engine::float_vector_2d uv;
+	float                   w = 1.0f;
+	engine::Pixel           tint;
+};
+
+// Holds the vertices of every decal drawn in a frame, decal instances keep only their
+// offset. The storage grows to the busiest frame so far and is reused after reset(),
+// so drawing decals does not allocate once the engine has warmed up. Pointers from
+// at() stay valid until the next allocate().
+class DecalArena {
+public:
+	uint32_t allocate(uint32_t count);
+	DecalVertex*       at(uint32_t offset);
+	const DecalVertex* at(uint32_t offset) const;
+	uint32_t size() const;
+	void     reset();
+
+private:
+	std::vector<DecalVertex> vertices;
+	uint32_t used = 0;
+};
+
+#endif
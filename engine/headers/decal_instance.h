@@ -1,18 +1,25 @@
 #ifndef DECAL_INS_DEF
 #define DECAL_INS_DEF
 
+class DecalList;
+
 struct DecalInstance {
 	engine::Decal* decal = nullptr;
+	// set when the instance stands for a whole retained list, which holds the vertices
+	engine::DecalList* list = nullptr;
 
-	std::vector<engine::float_vector_2d> pos;
-	std::vector<engine::float_vector_2d> uv;
-	std::vector<float> w;
-	std::vector<engine::Pixel> tint;
+	// the vertices are points entries of the frame's decal arena, from first on
+	uint32_t first = 0;
+	uint32_t points = 0;
+	// a sprite batch when non-zero, first is then where its records start in the frame's sprite quads
+	uint32_t quads = 0;
 
 	engine::DecalMode mode = engine::DecalMode::NORMAL;
 	engine::DecalStructure structure = engine::DecalStructure::FAN;
 
-	uint32_t points = 0;
+	// scissor rectangle in screen pixels, half open, when clipped
+	bool    clipped = false;
+	int32_t clip_x1 = 0, clip_y1 = 0, clip_x2 = 0, clip_y2 = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
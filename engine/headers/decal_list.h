@@ -0,0 +1,34 @@
+#ifndef DECAL_LIST_DEF
+#define DECAL_LIST_DEF
+
+// Decals recorded once and drawn by reference every frame, for geometry that rarely
+// changes. Decals drawn between Engine::begin_decal_list and end_decal_list land here
+// instead of on a layer; Engine::draw_decal_list then costs one instance per frame.
+// Clipping is applied where the list is drawn, not where it was recorded. Renderers
+// may keep a copy of the vertices, so the list has to outlive the frames it is drawn in.
+class DecalList {
+public:
+	DecalList() = default;
+	DecalList(const DecalList&) = delete;
+	DecalList& operator=(const DecalList&) = delete;
+	~DecalList();
+
+	// drops the recorded decals, the list draws nothing until it is recorded again
+	void invalidate();
+	bool is_valid() const;
+	uint32_t get_revision() const;
+
+public:
+	// the renderer's handle for its copy, 0 while it holds none
+	uint32_t id = 0;
+	std::vector<DecalInstance> instances;
+	DecalArena arena;
+
+private:
+	uint32_t revision = 0;
+	bool valid = false;
+
+	friend class Engine;
+};
+
+#endif
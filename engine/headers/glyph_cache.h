@@ -0,0 +1,75 @@
+#ifndef GLYPH_CACHE_DEF
+#define GLYPH_CACHE_DEF
+
+// The 8x8 font as one 64 bit mask per glyph, bit y * 8 + x for a lit texel,
+// plus the runs of lit texels laid out for each scale up to max_scale. Glyphs
+// 0 to 95 are the characters 32 to 127. Proportional glyphs are shifted to
+// start at column 0. update() and prepare() build on the engine thread;
+// the rest only reads, so worker threads can draw text.
+class GlyphCache {
+public:
+	// one horizontal run of pixels, relative to the top left of the glyph
+	struct Run {
+		int16_t x1, x2, y;
+	};
+
+	// A string laid out against the font decal as a triangle list, six vertices
+	// per glyph. quads holds the top left and bottom right of every glyph in
+	// pixels from the string origin, the rest holds one entry per vertex.
+	struct TextMesh {
+		std::vector<engine::float_vector_2d> quads;
+		std::vector<engine::float_vector_2d> uv;
+		std::vector<engine::Pixel>           tint;
+		std::vector<float>                   w;
+	};
+
+	static constexpr uint32_t max_scale = 8;
+
+	// rebuilds the masks when the font sprite has changed since the last call
+	void update(const engine::Sprite* font, const std::vector<engine::int_vector_2d>& spacing);
+	void prepare(uint32_t scale);
+
+	// -1 for characters without a glyph, which draw nothing
+	static int32_t glyph_of(char c);
+
+	uint64_t   get_mask(int32_t glyph, bool prop) const;
+	int32_t    get_width(int32_t glyph, bool prop) const;
+	// nullptr when the scale has no runs prepared
+	const Run* get_runs(int32_t glyph, bool prop, uint32_t scale, int32_t& count) const;
+
+	// cached per string, the cache is dropped once it holds max_sizes strings
+	engine::int_vector_2d text_size(const std::string& s, bool prop);
+	// cached per string, scale and colour, the cache is dropped once it holds max_meshes strings
+	const TextMesh& text_mesh(const std::string& s, bool prop, const engine::float_vector_2d& scale, engine::Pixel col, const engine::float_vector_2d& uv_scale);
+
+private:
+	static constexpr size_t max_sizes = 1024;
+	static constexpr size_t max_meshes = 256;
+
+	struct MeshKey {
+		std::string text;
+		float       sx, sy;
+		uint32_t    col;
+		bool        prop;
+		bool operator==(const MeshKey& k) const { return text == k.text && sx == k.sx && sy == k.sy && col == k.col && prop == k.prop; }
+	};
+	struct MeshHash {
+		size_t operator()(const MeshKey& k) const { return std::hash<std::string>()(k.text) ^ (size_t(k.col) * 31) ^ (k.prop ? 1 : 0); }
+	};
+
+	struct Scale {
+		std::vector<Run>          runs;
+		std::array<uint32_t, 193> first;
+	};
+
+	std::array<uint64_t, 192> masks = {};
+	std::array<uint8_t, 96>   widths = {};
+	std::array<uint8_t, 96>   starts = {};
+	std::array<Scale, max_scale + 1> scales;
+	std::unordered_map<std::string, engine::int_vector_2d> sizes[2];
+	std::unordered_map<MeshKey, TextMesh, MeshHash> meshes;
+	uint32_t font_revision = 0;
+	bool     built = false;
+};
+
+#endif
@@ -13,6 +13,8 @@ struct LayerDesc {
     uint32_t res_ID = 0;
 	std::vector<DecalInstance> decal_instances;
 	engine::Pixel tint = engine::WHITE;
+	// Drawn in place of the layer, once the layers below it are on screen. Decals the hook
+	// draws onto layers above it are drawn this frame, onto itself or below they are dropped.
 	std::function<void()> func_hook = nullptr;
 };
 
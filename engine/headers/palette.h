@@ -0,0 +1,36 @@
+#ifndef PALETTE_DEF
+#define PALETTE_DEF
+
+// Up to 256 colours shared by indexed sprites and draw targets. Those store
+// one index per texel, so changing or cycling entries recolours every user
+// without touching its texels. Entries are changed through set() and cycle(),
+// which keep the revision current.
+class Palette {
+public:
+	Palette(uint32_t size = 256);
+	Palette(const std::vector<engine::Pixel>& colours);
+
+	void  set(uint8_t index, Pixel p);
+	Pixel get(uint8_t index) const;
+
+	// rotates the entries first to last by step, for colour cycling; the lookup tables are
+	// moved along with them rather than rebuilt
+	void cycle(uint8_t first, uint8_t last, int32_t step = 1);
+
+	// The entry equal to p, or else the nearest in colour. Needs update() after the
+	// entries changed, which the engine calls before drawing to indexed targets.
+	uint8_t find(Pixel p) const;
+	void    update();
+
+	std::array<engine::Pixel, 256> colours;
+	uint32_t size = 256;
+	uint32_t revision = 0;
+
+private:
+	// exact holds index + 1 by a hash of the colour, nearest covers 4 bit per channel rgb
+	std::array<uint16_t, 512>  exact;
+	std::array<uint8_t, 4096>  nearest;
+	uint32_t table_revision = uint32_t(-1);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef RASTER_DEF
+#define RASTER_DEF
+
+class Sprite;
+
+// Snapshot of the draw target and blend state handed to the primitives.
+// Primitives are templated on the pixel mode, so the mode is resolved once
+// per primitive instead of once per pixel. Writes are limited to the clip
+// rectangle, which is half open. Indexed targets write palette indices to
+// indices instead of data; colours are matched to the nearest palette entry
+// and blends read the palette colour under them.
+struct Raster {
+	Pixel*   data = nullptr;
+	uint8_t* indices = nullptr;
+	const engine::Palette* palette = nullptr;
+	int32_t  width = 0;
+	int32_t  height = 0;
+	int32_t  pitch = 0;
+	uint32_t weight = 256;
+	int32_t  clip_x1 = 0, clip_y1 = 0, clip_x2 = 0, clip_y2 = 0;
+	const std::function<Pixel(const int x, const int y, const Pixel&, const Pixel&)>* custom = nullptr;
+	// when set, CUSTOM writes call owner->draw instead of custom, so an override sees every pixel
+	Engine*  owner = nullptr;
+
+	template<Pixel::Mode M> bool plot(int32_t x, int32_t y, Pixel p) const;
+	// plot without the clip test, for pixels already known to be inside the clip rectangle;
+	// write takes the offset of x, y in the target, for loops that step it themselves
+	template<Pixel::Mode M> bool put  (int32_t x, int32_t y, Pixel p) const;
+	template<Pixel::Mode M> bool write(int32_t offset, int32_t x, int32_t y, Pixel p) const;
+	// blends p with its weight scaled by coverage, 0 to 256, whatever the mode short of CUSTOM
+	template<Pixel::Mode M> void cover(int32_t x, int32_t y, Pixel p, uint32_t coverage) const;
+	template<Pixel::Mode M> void span(int32_t x1, int32_t x2, int32_t y, Pixel p) const;
+	template<Pixel::Mode M> void row (int32_t x, int32_t y, const Pixel* src, int32_t step, int32_t count) const;
+
+	// Writes indices of the target's own palette, which keeps them exact for palette effects.
+	template<Pixel::Mode M> void row_indexed(int32_t x, int32_t y, const uint8_t* src, int32_t step, int32_t count) const;
+
+	// the CUSTOM write of p over the pixel or index at x, y
+	bool shade(Pixel& d, int32_t x, int32_t y, Pixel p) const;
+	bool shade(uint8_t& i, int32_t x, int32_t y, Pixel p) const;
+
+	// Draws the w by h texels at ox, oy of the sprite at x, y, flipped as given. The scaled
+	// form stretches them over dw by dh pixels, picking the nearest texel.
+	template<Pixel::Mode M> void blit       (int32_t x, int32_t y, const engine::Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint8_t flip) const;
+	template<Pixel::Mode M> void blit_scaled(int32_t x, int32_t y, int32_t dw, int32_t dh, const engine::Sprite* sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint8_t flip) const;
+
+	// Calls span(x1, x2, y) for every row of pixels covered by the triangle,
+	// whose vertices are given in fixed point with subpixel_bits fraction bits.
+	template<typename F> void triangle(const int32_t* x, const int32_t* y, F&& span) const;
+
+	// true when the half open box lies inside the clip rectangle, false when it may not
+	bool contains(int32_t x1, int32_t y1, int32_t x2, int32_t y2) const { return x1 >= clip_x1 && y1 >= clip_y1 && x2 <= clip_x2 && y2 <= clip_y2; }
+
+	static constexpr int32_t subpixel_bits = 4;
+};
+
+// Calls f with a std::integral_constant for the given mode.
+template<typename F> void dispatch_mode(Pixel::Mode mode, F&& f) {
+	switch (mode) {
+	case Pixel::NORMAL: f(std::integral_constant<Pixel::Mode, Pixel::NORMAL>()); break;
+	case Pixel::MASK:   f(std::integral_constant<Pixel::Mode, Pixel::MASK>());   break;
+	case Pixel::ALPHA:  f(std::integral_constant<Pixel::Mode, Pixel::ALPHA>());  break;
+	case Pixel::CUSTOM: f(std::integral_constant<Pixel::Mode, Pixel::CUSTOM>()); break;
+	}
+}
+
+#endif
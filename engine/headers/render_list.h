@@ -0,0 +1,69 @@
+#ifndef RENDER_LIST_DEF
+#define RENDER_LIST_DEF
+
+// One renderer call of a frame. The fields are used per type:
+//   VIEWPORT      rect                           window pixels
+//   SCISSOR       rect                           window pixels, a size of zero turns it off
+//   CLEAR         col                            count = depth
+//   LAYER         texture, transform, col        transform = offset, scale; col = tint
+//   DECAL         decal, vertices
+//   DECAL_LIST    list
+//   SPRITE_BATCH  decal, quads, count
+struct RenderCommand {
+	enum Type : uint8_t {
+		VIEWPORT,
+		SCISSOR,
+		CLEAR,
+		LAYER,
+		DECAL,
+		DECAL_LIST,
+		SPRITE_BATCH
+	};
+
+	Type          type = VIEWPORT;
+	uint32_t      texture = 0;
+	uint32_t      count = 0;
+	engine::Pixel col;
+
+	union {
+		int32_t rect[4] = { 0, 0, 0, 0 };
+		float   transform[4];
+	};
+
+	const DecalInstance* decal = nullptr;
+	union {
+		const DecalVertex*           vertices = nullptr;
+		const SpriteQuad*            quads;
+		DecalList*                   list;
+	};
+};
+
+static_assert(std::is_trivially_copyable<RenderCommand>::value, "render commands are copied as plain memory");
+
+// A frame of renderer calls, recorded by the engine and run by Renderer::execute in one go.
+// Commands point at the frame's decal instances, arena vertices and sprite quads, so a
+// list is only good until the frame ends. Within that the commands are plain
+// data: a list can be copied, reordered, checked or run again.
+class RenderList {
+public:
+	void viewport(const engine::int_vector_2d& pos, const engine::int_vector_2d& size);
+	void scissor(const engine::int_vector_2d& pos, const engine::int_vector_2d& size);
+	void clear_buffer(engine::Pixel p, bool depth);
+	void layer(uint32_t texture, const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, engine::Pixel tint);
+	void decal(const DecalInstance& decal, const DecalVertex* vertices);
+	void decal_list(DecalList& list);
+	void sprite_batch(const DecalInstance& decal, const SpriteQuad* quads, uint32_t count);
+
+	// true when every command has what it needs and nothing is drawn before the first layer
+	bool validate() const;
+	void reset();
+
+	std::vector<RenderCommand> commands;
+	// one over the screen size, sprite batches are placed in screen pixels
+	engine::float_vector_2d inv_screen_size = { 1.0f, 1.0f };
+
+private:
+	RenderCommand& push(RenderCommand::Type type);
+};
+
+#endif
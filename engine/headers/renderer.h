@@ -11,17 +11,23 @@ public:
 	virtual engine::Code destroy_device() = 0;
 
 	virtual void       display_frame  () = 0;
-	virtual void       prepare_drawing() = 0;
-	virtual void	   set_decal_mode (const engine::DecalMode& mode) = 0;
-	virtual void       draw_layer_quad(const engine::float_vector_2d& offset, const engine::float_vector_2d& scale, const engine::Pixel tint) = 0;
-	virtual void       draw_decal     (const engine::DecalInstance& decal) = 0;
+	// Runs a recorded list in order, see RenderList. Decals may be held back to batch them,
+	// but everything in the list has been drawn by the time this returns. Layer hooks are
+	// called by the engine between lists, never while one runs.
+	virtual void       execute        (const engine::RenderList& list) = 0;
+	// a renderer may keep its own copy of a decal list under list.id, this drops it
+	virtual void       delete_decal_list(uint32_t id) = 0;
+	// when false the engine expands sprite batches into plain decals, no SPRITE_BATCH is ever recorded
+	virtual bool       supports_instancing() = 0;
 	virtual uint32_t   create_texture (const uint32_t width, const uint32_t height, const bool filtered = false, const bool clamp = true) = 0;
 	virtual void       update_texture (uint32_t id, engine::Sprite* spr) = 0;
+	// uploads the w by h texels at x, y into the texture, which already has the size of the sprite
+	virtual void       update_texture_region(uint32_t id, engine::Sprite* spr, int32_t x, int32_t y, int32_t w, int32_t h) = 0;
 	virtual void       read_texture   (uint32_t id, engine::Sprite* spr) = 0;
 	virtual uint32_t   delete_texture (const uint32_t id) = 0;
 	virtual void       apply_texture  (uint32_t id) = 0;
+	// for setting up a device before its first frame, frames carry their own viewport
 	virtual void       update_viewport(const engine::int_vector_2d& pos, const engine::int_vector_2d& size) = 0;
-	virtual void       clear_buffer   (engine::Pixel p, bool depth) = 0;
 
 	static engine::Engine* ptr_engine;
 };
@@ -0,0 +1,15 @@
+#ifndef SPAN_DEF
+#define SPAN_DEF
+
+// Blending uses 8.8 fixed point; a weight of 256 is fully opaque.
+// A negative step walks the source backwards (horizontally flipped rows).
+uint32_t blend_weight(float blend);
+Pixel    blend_pixel (const Pixel& src, const Pixel& dest, uint32_t weight);
+
+void span_fill       (Pixel* dest, const Pixel& src, int32_t count);
+void span_copy       (Pixel* dest, const Pixel* src, int32_t step, int32_t count);
+void span_mask       (Pixel* dest, const Pixel* src, int32_t step, int32_t count);
+void span_blend      (Pixel* dest, const Pixel* src, int32_t step, int32_t count, uint32_t weight);
+void span_blend_solid(Pixel* dest, const Pixel& src, int32_t count, uint32_t weight);
+
+#endif
@@ -1,11 +1,38 @@
 #ifndef SPRITE_DEF
 #define SPRITE_DEF
 
+// Allocates blocks starting on an A byte boundary. The distance to the block
+// operator new returned is kept in the byte just before the aligned start.
+template<typename T, size_t A = 64>
+struct AlignedAllocator {
+	using value_type = T;
+	template<typename U> struct rebind { using other = AlignedAllocator<U, A>; };
+
+	AlignedAllocator() = default;
+	template<typename U> AlignedAllocator(const AlignedAllocator<U, A>&) {}
+
+	T* allocate(size_t n) {
+		uint8_t* raw = static_cast<uint8_t*>(::operator new(n * sizeof(T) + A));
+		uint8_t* p = raw + (A - reinterpret_cast<uintptr_t>(raw) % A);
+		p[-1] = uint8_t(p - raw);
+		return reinterpret_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t) {
+		uint8_t* b = reinterpret_cast<uint8_t*>(p);
+		::operator delete(b - b[-1]);
+	}
+
+	template<typename U> bool operator==(const AlignedAllocator<U, A>&) const { return true; }
+	template<typename U> bool operator!=(const AlignedAllocator<U, A>&) const { return false; }
+};
+
 class Sprite {
 public:
 	Sprite();
 	Sprite(const std::string& img_file, engine::ResourcePack* pack = nullptr);
 	Sprite(int32_t w, int32_t h);
+	Sprite(int32_t w, int32_t h, engine::Palette* palette);
 	Sprite(const engine::Sprite&) = delete;
 	~Sprite();
     
@@ -14,6 +41,14 @@ public:
 	int32_t width = 0;
 	int32_t height = 0;
 
+	// Texels from one row to the next. Rows are padded to whole cache lines, so every row
+	// of col_data starts 64 byte aligned; index_data uses the same pitch.
+	int32_t pitch = 0;
+	static constexpr int32_t row_alignment = 64;
+
+	// Reallocates for the new size, leaving the contents undefined.
+	void resize(int32_t w, int32_t h);
+
 	enum Mode { 
         NORMAL, 
         PERIODIC, 
@@ -34,22 +69,115 @@ public:
 	bool  set_pixel(int32_t x, int32_t y, Pixel p);
 	bool  set_pixel(const engine::int_vector_2d& a, Pixel p);
 
+	// Indexed sprites hold one palette index per texel in index_data and no pixels, so
+	// get_data() is empty for them. set_palette() converts an RGBA sprite, swaps the
+	// palette of an indexed one in place, or converts back to RGBA given nullptr.
+	void           set_palette(engine::Palette* palette);
+	bool           is_indexed() const;
+	uint8_t        get_index(int32_t x, int32_t y) const;
+	bool           set_index(int32_t x, int32_t y, uint8_t index);
+	uint8_t*       get_indices();
+	const uint8_t* get_indices() const;
+	void           expand(engine::Pixel* out) const; // pitch * height pixels
+
 	Pixel sample(float x, float y) const;
 	Pixel sample(const engine::float_vector_2d& uv) const;
 
 	Pixel sample_BL(float u, float v) const;
 	Pixel sample_BL(const engine::float_vector_2d& uv) const;
 
+	// Samples count coordinates at once, normalised like sample(). lod is log2 of the
+	// texels one pixel covers; sample_TL blends the two nearest mip levels.
+	void sample_BL(const float* u, const float* v, Pixel* out, int32_t count) const;
+	void sample_TL(const float* u, const float* v, const float* lod, Pixel* out, int32_t count) const;
+
+	// Mip levels are box filtered halvings of the sprite. Once enabled they are built by
+	// update_mipmaps(), which the engine calls before drawing with the sprite, and rebuilt
+	// after the pixels changed.
+	void    enable_mipmaps(bool enable = true);
+	void    update_mipmaps();
+	int32_t mip_count() const;
+
+	// The compiled form splits every row into runs of opaque texels, which are copied, and
+	// partly transparent texels, which are blended. Fully transparent texels fall between
+	// runs and are skipped. Like the mip levels, the runs are built by update_compiled()
+	// and only used while they match the pixels.
+	struct Run {
+		int32_t x;
+		int32_t count;
+		bool    opaque;
+	};
+
+	void       enable_compiled(bool enable = true);
+	void       update_compiled();
+	bool       is_compiled() const;
+	const Run* get_runs(int32_t y, int32_t& count) const;
+
+	// Writable access counts as a write. Call mark_dirty() after writing through a
+	// pointer that was taken earlier.
 	Pixel* get_data();
+	const Pixel* get_data() const;
+	void mark_dirty();
+
+	// The region written since clear_dirty(), so decals upload only that. Writes through
+	// get_data() or mark_dirty() cover the whole sprite; set_pixel() and the engine's
+	// drawing mark what they touch. get_dirty() is false when nothing was written.
+	void mark_dirty(int32_t x, int32_t y, int32_t w, int32_t h);
+	bool get_dirty(int32_t& x, int32_t& y, int32_t& w, int32_t& h) const;
+	void clear_dirty();
+	// the revision at the last clear_dirty(), the dirty region holds every write since
+	uint32_t dirty_revision() const;
 
 	engine::Sprite* duplicate();
 	engine::Sprite* duplicate(const engine::int_vector_2d& pos, const engine::int_vector_2d& size);
 
 	engine::int_vector_2d size() const;
-	std::vector<engine::Pixel> col_data;
+	std::vector<engine::Pixel, engine::AlignedAllocator<engine::Pixel>> col_data;
+	std::vector<uint8_t> index_data;
+	engine::Palette* palette = nullptr;
 	Mode sample_mode = Mode::NORMAL;
 
+	// changes whenever the pixels may have changed; bumping it after writing col_data
+	// directly makes decals upload the whole sprite
+	uint32_t revision = 0;
+
 	static std::unique_ptr<engine::ImageLoader> loader;
+
+private:
+	// What the colours were made from, caches keep the one they were built at. A default
+	// Version matches no sprite, so assigning one drops the cache.
+	struct Version {
+		uint32_t               revision = 0;
+		const engine::Palette* palette = nullptr;
+		uint32_t               palette_revision = 0;
+		bool                   valid = false;
+
+		bool operator==(const Version& v) const { return revision == v.revision && palette == v.palette && palette_revision == v.palette_revision && valid == v.valid; }
+		bool operator!=(const Version& v) const { return !(*this == v); }
+	};
+
+	Version version() const;
+
+	int32_t  dirty_x1 = 0, dirty_y1 = 0, dirty_x2 = 0, dirty_y2 = 0;
+	uint32_t clean_revision = 0;
+
+	struct MipLevel {
+		int32_t width = 0;
+		int32_t height = 0;
+		std::vector<engine::Pixel> data;
+	};
+
+	void sample_level(int32_t level, const float* u, const float* v, uint32_t* out, int32_t count) const;
+
+	std::vector<MipLevel> mip_levels;
+	Version  mip_version;
+	bool     mipmaps = false;
+
+	// the runs of row y are runs[row_runs[y]] up to runs[row_runs[y + 1]]
+	std::vector<Run>      runs;
+	std::vector<uint32_t> row_runs;
+	Version  runs_version;
+	bool     compiled = false;
 };
 
 #endif
\ No newline at end of file
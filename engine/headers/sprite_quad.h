@@ -0,0 +1,17 @@
+#ifndef SPRITE_QUAD_DEF
+#define SPRITE_QUAD_DEF
+
+// One sprite of Engine::draw_sprite_batch: the source rectangle of the decal in pixels,
+// scaled and rotated by angle about center, which lands on pos in screen pixels. Renderers
+// that instance upload these as they are, so the layout stays plain.
+struct SpriteQuad {
+	engine::float_vector_2d pos;
+	engine::float_vector_2d source_pos;
+	engine::float_vector_2d source_size;
+	engine::float_vector_2d center;
+	engine::float_vector_2d scale = { 1.0f, 1.0f };
+	float                   angle = 0.0f;
+	engine::Pixel           tint = engine::WHITE;
+};
+
+#endif
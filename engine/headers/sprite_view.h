@@ -0,0 +1,39 @@
+#ifndef SPRITE_VIEW_DEF
+#define SPRITE_VIEW_DEF
+
+// A rectangle of a Sprite, used in its place without copying it, so a sheet can be
+// sliced into frames for free. Views share the sprite's storage and stay valid until
+// it is resized. Coordinates are relative to the view; the sprite's sample mode
+// applies at the edges of the view rather than those of the sprite.
+struct SpriteView {
+	engine::Sprite* sprite = nullptr;
+	int32_t x = 0;
+	int32_t y = 0;
+	int32_t width = 0;
+	int32_t height = 0;
+
+	SpriteView() = default;
+	SpriteView(engine::Sprite* sprite);
+	SpriteView(engine::Sprite* sprite, int32_t x, int32_t y, int32_t w, int32_t h);
+
+	// the part of the rectangle inside this view, as a view of the same sprite
+	SpriteView sub(int32_t x, int32_t y, int32_t w, int32_t h) const;
+
+	// rows of get_data() are pitch() texels apart
+	int32_t      pitch() const;
+	Pixel*       get_data();
+	const Pixel* get_data() const;
+
+	Pixel get_pixel(int32_t x, int32_t y) const;
+	bool  set_pixel(int32_t x, int32_t y, Pixel p);
+
+	Pixel sample(float x, float y) const;
+	Pixel sample(const engine::float_vector_2d& uv) const;
+	Pixel sample_BL(float u, float v) const;
+	Pixel sample_BL(const engine::float_vector_2d& uv) const;
+
+	engine::Sprite* duplicate() const;
+	engine::int_vector_2d size() const;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef TILE_RASTER_DEF
+#define TILE_RASTER_DEF
+
+// Bins recorded draw commands into screen tiles and rasterizes the tiles on
+// a pool of worker threads. Every tile replays its bin in recording order,
+// so the result matches drawing on the engine thread.
+class TileRaster {
+public:
+	TileRaster(uint32_t worker_count, int32_t size);
+	~TileRaster();
+
+	void bin(const std::vector<DrawCommand>& commands, int32_t width, int32_t height);
+	void run(int32_t count, const std::function<void(int32_t)>& job);
+
+	int32_t tile_size;
+	int32_t tiles_x = 0;
+	int32_t tiles_y = 0;
+
+	std::vector<std::vector<uint32_t>> bins;
+
+private:
+	void work();
+	void worker_loop();
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(int32_t)>* task = nullptr;
+	std::atomic<int32_t> next = { 0 };
+	int32_t  task_count = 0;
+	uint32_t busy = 0;
+	uint64_t generation = 0;
+	bool     quit = false;
+};
+
+#endif
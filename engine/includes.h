@@ -8,11 +8,16 @@
 #include <chrono>
 #include <vector>
 #include <list>
+#include <deque>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <fstream>
 #include <map>
+#include <unordered_map>
 #include <functional>
+#include <type_traits>
 #include <algorithm>
 #include <array>
 #include <cstring>
@@ -32,11 +32,15 @@
 		#include <emscripten/emscripten.h>
 		#define CALLSTYLE
 		#define GL_CLAMP GL_CLAMP_TO_EDGE
+		// WebGL 2 has row lengths, the GLES2 headers just do not name them
+		#define GL_UNPACK_ROW_LENGTH 0x0CF2
+		#define GL_PACK_ROW_LENGTH 0x0D02
 	#endif
 
 namespace engine {
 	typedef char GLchar;
 	typedef ptrdiff_t GLsizeiptr;
+	typedef ptrdiff_t GLintptr;
 
 	typedef GLuint CALLSTYLE locCreateShader_t(GLenum type);
 	typedef GLuint CALLSTYLE locCreateProgram_t(void);
@@ -47,12 +51,17 @@ namespace engine {
 	typedef void CALLSTYLE locAttachShader_t(GLuint program, GLuint shader);
 	typedef void CALLSTYLE locBindBuffer_t(GLenum target, GLuint buffer);
 	typedef void CALLSTYLE locBufferData_t(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+	typedef void CALLSTYLE locBufferSubData_t(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
 	typedef void CALLSTYLE locGenBuffers_t(GLsizei n, GLuint* buffers);
+	typedef void CALLSTYLE locDeleteBuffers_t(GLsizei n, const GLuint* buffers);
 	typedef void CALLSTYLE locVertexAttribPointer_t(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
 	typedef void CALLSTYLE locEnableVertexAttribArray_t(GLuint index);
 	typedef void CALLSTYLE locUseProgram_t(GLuint program);
 	typedef void CALLSTYLE locBindVertexArray_t(GLuint array);
 	typedef void CALLSTYLE locGenVertexArrays_t(GLsizei n, GLuint* arrays);
+	typedef void CALLSTYLE locDeleteVertexArrays_t(GLsizei n, const GLuint* arrays);
+	typedef void CALLSTYLE locVertexAttribDivisor_t(GLuint index, GLuint divisor);
+	typedef void CALLSTYLE locDrawArraysInstanced_t(GLenum mode, GLint first, GLsizei count, GLsizei instances);
 	typedef void CALLSTYLE locGetShaderInfoLog_t(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog);
 	typedef GLint CALLSTYLE locGetUniformLocation_t(GLuint program, const GLchar* name);
 	typedef void CALLSTYLE locUniform1f_t(GLint location, GLfloat v0);